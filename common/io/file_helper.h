@@ -26,6 +26,11 @@
 #include <string>
 #include <thread>
 #include <chrono>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
 
 #include <common/util/os_spec.h>
 
@@ -98,8 +103,11 @@ public:
 
     void Write(const LogMessage &msg)
     {
-        size_t size = msg.formatted.size();
-        auto data = msg.formatted.data();
+        Write(msg.formatted.data(), msg.formatted.size());
+    }
+
+    void Write(const char* data, std::size_t size)
+    {
         if (std::fwrite(data, 1, size, fd_) != size)
         {
             throw SimpleException("failed writing to file " + filename_);
@@ -110,6 +118,44 @@ public:
         }
     }
 
+    // write the formatted text of every record at or above min_level.
+    // on posix the records go out with as few writev() calls as possible,
+    // after flushing whatever stdio still buffers so the order is kept
+    void WriteBatch(const LogMessage* const* msgs, std::size_t count,
+                    LevelEnum min_level)
+    {
+#ifdef _WIN32
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (msgs[i]->level >= min_level)
+            {
+                Write(*msgs[i]);
+            }
+        }
+#else
+        const std::size_t max_iov = 64;
+        struct iovec iov[max_iov];
+        std::fflush(fd_);
+        std::size_t i = 0;
+        while (i < count)
+        {
+            int iovcnt = 0;
+            for (; i < count && iovcnt < static_cast<int>(max_iov); ++i)
+            {
+                const LogMessage& msg = *msgs[i];
+                if (msg.level < min_level || !msg.formatted.size())
+                {
+                    continue;
+                }
+                iov[iovcnt].iov_base = const_cast<char*>(msg.formatted.data());
+                iov[iovcnt].iov_len = msg.formatted.size();
+                ++iovcnt;
+            }
+            _WriteV(iov, iovcnt);
+        }
+#endif
+    }
+
     const std::string& filename() const { return filename_; }
     static bool FileExists(const std::string& name)
     {
@@ -124,6 +170,38 @@ public:
         }
     }
 private:
+#ifndef _WIN32
+    // writev() until every byte is out, resuming after short writes
+    void _WriteV(struct iovec* iov, int iovcnt)
+    {
+        int fd = fileno(fd_);
+        while (iovcnt > 0)
+        {
+            ssize_t written = ::writev(fd, iov, iovcnt);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw SimpleException("failed writing to file " + filename_);
+            }
+            std::size_t left = static_cast<std::size_t>(written);
+            while (iovcnt > 0 && left >= iov->iov_len)
+            {
+                left -= iov->iov_len;
+                ++iov;
+                --iovcnt;
+            }
+            if (iovcnt > 0)
+            {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+                iov->iov_len -= left;
+            }
+        }
+    }
+#endif
+
     std::FILE *fd_;
     std::string filename_;
     bool force_flush_;
@@ -32,6 +32,8 @@
 #include <common/log/sinks/sink.h>
 #include <common/container/queue/mpmc_bounded_queue.h>
 #include <common/log/log_message.h>
+#include <common/log/logger_settings.h>
+#include <common/log/dispatch.h>
 #include <common/util/format.h>
 
 namespace pb
@@ -45,7 +47,9 @@ class AsyncLogHelper
         std::string logger_name;
         LevelEnum level;
         log_clock::time_point time;
+        std::size_t thread_id;
         std::string txt;
+        ContextSnapshot context;
 
         AsyncMsg() = default;
         ~AsyncMsg() = default;
@@ -54,7 +58,9 @@ class AsyncLogHelper
             logger_name(std::move(other.logger_name)),
             level(std::move(other.level)),
             time(std::move(other.time)),
-            txt(std::move(other.txt))
+            thread_id(other.thread_id),
+            txt(std::move(other.txt)),
+            context(std::move(other.context))
         {}
 
         AsyncMsg& operator=(AsyncMsg&& other) PB_NOEXCEPT
@@ -62,7 +68,9 @@ class AsyncLogHelper
             logger_name = std::move(other.logger_name);
             level = other.level;
             time = std::move(other.time);
+            thread_id = other.thread_id;
             txt = std::move(other.txt);
+            context = std::move(other.context);
             return *this;
         }
         // never copy or assign. should only be moved..
@@ -74,8 +82,11 @@ class AsyncLogHelper
             logger_name(m.logger_name),
             level(m.level),
             time(m.time),
+            thread_id(m.thread_id),
             txt(m.raw.data(), m.raw.size())
-        {}
+        {
+            context.Assign(m.context);
+        }
 
 
         // copy into log_msg
@@ -85,6 +96,8 @@ class AsyncLogHelper
             msg.logger_name = logger_name;
             msg.level = level;
             msg.time = time;
+            msg.thread_id = thread_id;
+            msg.context = context.View();
             msg.raw << txt;
         }
     };
@@ -97,8 +110,9 @@ public:
     using clock = std::chrono::steady_clock;
 
 
-    AsyncLogHelper(formatter_ptr formatter,
-                   const std::vector<sink_ptr>& sinks,
+    // the back thread writes with the settings in effect in the logger's
+    // slot, which must outlive the helper
+    AsyncLogHelper(const SettingsSlot& settings,
                    size_t queue_size,
                    const AsyncOverflowPolicy overflow_policy = AsyncOverflowPolicy::kBlockRetry,
                    const std::function<void()>& worker_warmup_cb = nullptr);
@@ -108,10 +122,8 @@ public:
     // stop logging and join the back thread
     virtual ~AsyncLogHelper();
 
-    void SetFormatter(formatter_ptr);
 private:
-    formatter_ptr _formatter;
-    std::vector<std::shared_ptr<Sink>> _sinks;
+    const SettingsSlot& _settings;
 
     // queue of messages to log
     q_type _q;
@@ -149,13 +161,11 @@ private:
 // async_sink class implementation
 ///////////////////////////////////////////////////////////////////////////////
 inline AsyncLogHelper::AsyncLogHelper(
-    formatter_ptr formatter,
-    const std::vector<sink_ptr>& sinks,
+    const SettingsSlot& settings,
     size_t queue_size,
     const AsyncOverflowPolicy overflow_policy,
     const std::function<void()>& worker_warmup_cb) :
-    _formatter(formatter),
-    _sinks(sinks),
+    _settings(settings),
     _q(queue_size),
     _overflow_policy(overflow_policy),
     _worker_warmup_cb(worker_warmup_cb),
@@ -235,11 +245,9 @@ inline bool AsyncLogHelper::ProcessNextMsg(clock::time_point& last_pop)
         }
 
         incoming_async_msg.FillLogMsg(incoming_log_msg);
-        _formatter->format(incoming_log_msg);
-        for (auto &s : _sinks)
-        {
-            s->Log(incoming_log_msg);
-        }
+        Epoch::Guard guard;
+        const LoggerSettings& settings = _settings.get();
+        DispatchMsg(incoming_log_msg, settings.sinks, settings.formatter.get());
     }
     else //empty queue
     {
@@ -248,12 +256,6 @@ inline bool AsyncLogHelper::ProcessNextMsg(clock::time_point& last_pop)
     return true;
 }
 
-inline void AsyncLogHelper::SetFormatter(formatter_ptr msg_formatter)
-{
-    _formatter = msg_formatter;
-}
-
-
 // sleep,yield or return immediatly using the time passed since last message as a hint
 inline void AsyncLogHelper::SleepOrYield(const clock::time_point& last_op_time)
 {
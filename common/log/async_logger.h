@@ -32,11 +32,105 @@
 //    2. Push a new copy of the message to a queue (or block the caller until space is available in the queue)
 //    3. will throw spdlog_ex upon log exceptions
 // Upong destruction, logs all remaining messages in the queue before destructing..
+//
+// The back thread writes with the sinks and formatter in effect when it
+// writes, which may be newer than those in effect when the message was logged.
 
 #include <chrono>
 #include <functional>
+#include <memory>
 #include "common_def.h"
 #include "logger.h"
-#include "log.h"
+#include "async_log_helper.h"
+
+namespace pb
+{
+class AsyncLogger : public Logger
+{
+public:
+    template<class It>
+    AsyncLogger(const std::string& name,
+                const It& begin,
+                const It& end,
+                size_t queue_size,
+                const AsyncOverflowPolicy overflow_policy = AsyncOverflowPolicy::kBlockRetry,
+                const std::function<void()>& worker_warmup_cb = nullptr);
+
+    AsyncLogger(const std::string& logger_name,
+                sinks_init_list sinks,
+                size_t queue_size,
+                const AsyncOverflowPolicy overflow_policy = AsyncOverflowPolicy::kBlockRetry,
+                const std::function<void()>& worker_warmup_cb = nullptr);
+
+    AsyncLogger(const std::string& logger_name,
+                sink_ptr single_sink,
+                size_t queue_size,
+                const AsyncOverflowPolicy overflow_policy = AsyncOverflowPolicy::kBlockRetry,
+                const std::function<void()>& worker_warmup_cb = nullptr);
+
+protected:
+    void _SinkMsg(LogMessage& msg, const LoggerSettings&) override;
+    // records are queued one by one, so other threads' messages may end up
+    // between them
+    void _SinkBatch(LogMessage* const* msgs, std::size_t count,
+                    const LoggerSettings&) override;
+    // writes what is queued and joins the back thread
+    void _Shutdown() override;
+
+private:
+    std::unique_ptr<AsyncLogHelper> async_log_helper_;
+};
+} // ns pb
+
+template<class It>
+inline pb::AsyncLogger::AsyncLogger(
+    const std::string& logger_name,
+    const It& begin,
+    const It& end,
+    size_t queue_size,
+    const AsyncOverflowPolicy overflow_policy,
+    const std::function<void()>& worker_warmup_cb) :
+    Logger(logger_name, begin, end),
+    async_log_helper_(new AsyncLogHelper(settings_, queue_size,
+                                         overflow_policy, worker_warmup_cb))
+{}
+
+inline pb::AsyncLogger::AsyncLogger(
+    const std::string& logger_name,
+    sinks_init_list sinks,
+    size_t queue_size,
+    const AsyncOverflowPolicy overflow_policy,
+    const std::function<void()>& worker_warmup_cb) :
+    AsyncLogger(logger_name, sinks.begin(), sinks.end(), queue_size,
+                overflow_policy, worker_warmup_cb) {}
+
+inline pb::AsyncLogger::AsyncLogger(
+    const std::string& logger_name,
+    sink_ptr single_sink,
+    size_t queue_size,
+    const AsyncOverflowPolicy overflow_policy,
+    const std::function<void()>& worker_warmup_cb) :
+    AsyncLogger(logger_name, { single_sink }, queue_size,
+                overflow_policy, worker_warmup_cb) {}
+
+inline void pb::AsyncLogger::_SinkMsg(LogMessage& msg, const LoggerSettings&)
+{
+    async_log_helper_->Log(msg);
+}
+
+inline void pb::AsyncLogger::_SinkBatch(LogMessage* const* msgs,
+                                        std::size_t count,
+                                        const LoggerSettings&)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        async_log_helper_->Log(*msgs[i]);
+    }
+}
+
+inline void pb::AsyncLogger::_Shutdown()
+{
+    async_log_helper_.reset();
+}
 
 #endif // PB_LOG_ASYNC_LOGGER_H_
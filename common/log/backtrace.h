@@ -0,0 +1,135 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-13 16:08:30
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-13 19:12:44
+*/
+
+#ifndef PB_LOG_BACKTRACE_H_
+#define PB_LOG_BACKTRACE_H_
+
+#include <cstring>
+#include <common/container/queue/mpmc_bounded_queue.h>
+#include "common_def.h"
+#include "log_message.h"
+
+namespace pb
+{
+// ring of the most recent messages which were below the logger threshold.
+// only the raw text is kept, pattern formatting happens if and when the ring
+// is dumped. capture is lock free and doesn't allocate: each entry keeps the
+// text in a slot of its own, cut at kMaxText characters. when the ring is
+// full the oldest entry is popped to make room.
+class Backtracer
+{
+public:
+    static const std::size_t kMaxText = 256;
+
+private:
+    // movable only, like AsyncLogHelper::AsyncMsg. moving copies the used
+    // part of the text slot
+    struct Entry
+    {
+        LevelEnum level;
+        log_clock::time_point time;
+        std::size_t thread_id;
+        std::size_t size;
+        char txt[kMaxText];
+        ContextSnapshot context;
+
+        Entry() : size(0) {}
+        Entry(Entry&& other) PB_NOEXCEPT
+        {
+            *this = std::move(other);
+        }
+
+        Entry& operator=(Entry&& other) PB_NOEXCEPT
+        {
+            level = other.level;
+            time = other.time;
+            thread_id = other.thread_id;
+            size = other.size;
+            std::memcpy(txt, other.txt, size);
+            context = std::move(other.context);
+            return *this;
+        }
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        explicit Entry(const LogMessage& m) :
+            level(m.level),
+            time(m.time),
+            thread_id(m.thread_id),
+            size(m.raw.size() < kMaxText ? m.raw.size() : kMaxText)
+        {
+            std::memcpy(txt, m.raw.data(), size);
+            context.Assign(m.context);
+        }
+    };
+
+public:
+    // capacity is rounded up to a power of two (queue requirement)
+    explicit Backtracer(std::size_t capacity) :
+        q_(RoundUpCapacity(capacity)) {}
+
+    Backtracer(const Backtracer&) = delete;
+    Backtracer& operator=(const Backtracer&) = delete;
+
+    void Push(const LogMessage& msg)
+    {
+        Entry entry(msg);
+        Entry dropped;
+        while (!q_.enqueue(std::move(entry)))
+        {
+            q_.dequeue(dropped);
+        }
+    }
+
+    // pop every stored message, oldest first, into msg and call f(msg)
+    template <class Func>
+    void Drain(LogMessage& msg, const Func& f)
+    {
+        Entry entry;
+        while (q_.dequeue(entry))
+        {
+            msg.clear();
+            msg.level = entry.level;
+            msg.time = entry.time;
+            msg.thread_id = entry.thread_id;
+            msg.context = entry.context.View();
+            msg.raw << fmt::StringRef(entry.txt, entry.size);
+            f(msg);
+        }
+    }
+
+private:
+    static std::size_t RoundUpCapacity(std::size_t n)
+    {
+        std::size_t capacity = 2;
+        while (capacity < n)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    mpmc_bounded_queue<Entry> q_;
+};
+} // ns pb
+
+#endif // PB_LOG_BACKTRACE_H_
@@ -0,0 +1,316 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-25 13:02:44
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-25 19:36:15
+*/
+
+#ifndef PB_LOG_BINARY_FORMAT_H_
+#define PB_LOG_BINARY_FORMAT_H_
+
+// Binary log file format, written by BinaryFileSink and read back by
+// tools/binlog_decoder.cc.
+//
+// A file is a sequence of frames:
+//
+//   u8 type | u32 size | size bytes of payload | u32 crc32
+//
+// the crc covering type, size and payload. Integers are little endian,
+// "varint" is LEB128 and "str" a varint length followed by the bytes.
+// Payloads by type:
+//
+//   kHeader  8 bytes kMagic | u64 base time (ns since epoch) | varint pid
+//            | str logger name
+//   kSite    varint site id | u8 level | varint line | str file
+//            | str function | str format | str argument types
+//   kEvent   varint site id | varint time delta | varint thread id
+//            | arguments
+//   kText    u8 level | varint time delta | varint thread id
+//            | str logger name | str text
+//
+// Time deltas are zigzag encoded nanoseconds from the previous record
+// (from the base time for the first one). Each time the sink opens the
+// file it writes a header, which resets the deltas and the sites; a site
+// record is written before the first event of the site. Argument types
+// are fmt::internal::Arg::Type values, one byte per argument, and the
+// arguments follow in that order: INT, UINT, CHAR as u32; LONG_LONG,
+// ULONG_LONG, DOUBLE, POINTER as u64 (doubles bit for bit); STRING as
+// str. long doubles are written as doubles, C strings as STRING, and
+// values of other types as STRING, formatted with {} by the caller.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <common/util/crc32.h>
+#include <common/util/format.h>
+
+namespace pb
+{
+namespace binlog
+{
+enum RecordType
+{
+    kHeader = 1,
+    kSite = 2,
+    kEvent = 3,
+    kText = 4
+};
+
+static const char kMagic[8] = {'P', 'B', 'B', 'L', 'O', 'G', '0', '1'};
+// type and size before the payload, crc after it
+static const std::size_t kFrameHeaderSize = 5;
+static const std::size_t kFrameOverhead = 9;
+// arguments per call site, a bound for the decoder's argument array
+static const std::size_t kMaxArgs = 64;
+
+inline void PutFixed32(std::string& buf, std::uint32_t v)
+{
+    char b[4] = {static_cast<char>(v), static_cast<char>(v >> 8),
+                 static_cast<char>(v >> 16), static_cast<char>(v >> 24)};
+    buf.append(b, 4);
+}
+
+inline void PutFixed64(std::string& buf, std::uint64_t v)
+{
+    PutFixed32(buf, static_cast<std::uint32_t>(v));
+    PutFixed32(buf, static_cast<std::uint32_t>(v >> 32));
+}
+
+inline void PutVarint(std::string& buf, std::uint64_t v)
+{
+    char b[10];
+    std::size_t n = 0;
+    for (; v >= 0x80; v >>= 7)
+    {
+        b[n++] = static_cast<char>(v | 0x80);
+    }
+    b[n++] = static_cast<char>(v);
+    buf.append(b, n);
+}
+
+inline std::uint64_t ZigZag(std::int64_t v)
+{
+    return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+inline std::int64_t UnZigZag(std::uint64_t v)
+{
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+inline void PutString(std::string& buf, const char* s, std::size_t size)
+{
+    PutVarint(buf, size);
+    buf.append(s, size);
+}
+
+// start a frame in buf. the payload is appended after it, then EndFrame
+inline void BeginFrame(std::string& buf, RecordType type)
+{
+    buf.push_back(static_cast<char>(type));
+    buf.append(4, '\0');
+}
+
+// patch the size of the frame starting at offset start and append the crc
+inline void EndFrame(std::string& buf, std::size_t start)
+{
+    std::uint32_t size = static_cast<std::uint32_t>(buf.size() - start - kFrameHeaderSize);
+    for (int i = 0; i < 4; ++i)
+    {
+        buf[start + 1 + i] = static_cast<char>(size >> (8 * i));
+    }
+    PutFixed32(buf, Crc32(buf.data() + start, buf.size() - start));
+}
+
+// bounds checked reads from a payload. a read past the end sets ok() to
+// false and returns zeros
+class Reader
+{
+public:
+    Reader(const char* data, std::size_t size) :
+        p_(reinterpret_cast<const unsigned char*>(data)),
+        end_(p_ + size),
+        ok_(true) {}
+
+    bool ok() const { return ok_; }
+    bool empty() const { return p_ == end_; }
+
+    std::uint8_t GetByte()
+    {
+        return _Have(1) ? *p_++ : 0;
+    }
+
+    std::uint32_t GetFixed32()
+    {
+        if (!_Have(4))
+        {
+            return 0;
+        }
+        std::uint32_t v = static_cast<std::uint32_t>(p_[0])
+                          | static_cast<std::uint32_t>(p_[1]) << 8
+                          | static_cast<std::uint32_t>(p_[2]) << 16
+                          | static_cast<std::uint32_t>(p_[3]) << 24;
+        p_ += 4;
+        return v;
+    }
+
+    std::uint64_t GetFixed64()
+    {
+        std::uint64_t lo = GetFixed32();
+        return lo | static_cast<std::uint64_t>(GetFixed32()) << 32;
+    }
+
+    std::uint64_t GetVarint()
+    {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64 && _Have(1); shift += 7)
+        {
+            unsigned char b = *p_++;
+            v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80))
+            {
+                return v;
+            }
+        }
+        ok_ = false;
+        return 0;
+    }
+
+    // a view into the payload
+    fmt::StringRef GetString()
+    {
+        std::uint64_t size = GetVarint();
+        if (!_Have(size))
+        {
+            return fmt::StringRef("", 0);
+        }
+        const char* s = reinterpret_cast<const char*>(p_);
+        p_ += size;
+        return fmt::StringRef(s, static_cast<std::size_t>(size));
+    }
+
+    const char* GetBytes(std::size_t size)
+    {
+        if (!_Have(size))
+        {
+            return nullptr;
+        }
+        const char* s = reinterpret_cast<const char*>(p_);
+        p_ += size;
+        return s;
+    }
+
+private:
+    bool _Have(std::uint64_t size)
+    {
+        if (ok_ && size <= static_cast<std::uint64_t>(end_ - p_))
+        {
+            return true;
+        }
+        ok_ = false;
+        return false;
+    }
+
+    const unsigned char* p_;
+    const unsigned char* end_;
+    bool ok_;
+};
+
+namespace details
+{
+typedef fmt::internal::Arg Arg;
+typedef fmt::internal::MakeValue<char> MakeValue;
+
+inline void PutArgString(std::string& buf, std::string& types, const char* s,
+                         std::size_t size)
+{
+    types.push_back(static_cast<char>(Arg::STRING));
+    PutString(buf, s, size);
+}
+
+// one argument, as fmt would see it
+template <typename T>
+inline void EncodeArg(std::string& buf, std::string& types, const T& arg)
+{
+    MakeValue value(arg);
+    Arg::Type type = static_cast<Arg::Type>(MakeValue::type(arg));
+    switch (type)
+    {
+    case Arg::INT:
+    case Arg::UINT:
+    case Arg::CHAR:
+        types.push_back(static_cast<char>(type));
+        PutFixed32(buf, value.uint_value);
+        break;
+    case Arg::LONG_LONG:
+    case Arg::ULONG_LONG:
+        types.push_back(static_cast<char>(type));
+        PutFixed64(buf, value.ulong_long_value);
+        break;
+    case Arg::DOUBLE:
+    case Arg::LONG_DOUBLE:
+    {
+        double d = type == Arg::DOUBLE ? value.double_value
+                                       : static_cast<double>(value.long_double_value);
+        std::uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        types.push_back(static_cast<char>(Arg::DOUBLE));
+        PutFixed64(buf, bits);
+        break;
+    }
+    case Arg::CSTRING:
+    {
+        // as fmt does when formatting it
+        if (!value.string.value)
+        {
+            throw fmt::FormatError("string pointer is null");
+        }
+        PutArgString(buf, types, value.string.value,
+                     std::strlen(value.string.value));
+        break;
+    }
+    case Arg::STRING:
+        PutArgString(buf, types, value.string.value, value.string.size);
+        break;
+    case Arg::POINTER:
+        types.push_back(static_cast<char>(Arg::POINTER));
+        PutFixed64(buf, reinterpret_cast<std::uintptr_t>(value.pointer));
+        break;
+    default:
+    {
+        fmt::MemoryWriter w;
+        w.write("{}", arg);
+        PutArgString(buf, types, w.data(), w.size());
+    }
+    }
+}
+
+inline void EncodeArgs(std::string&, std::string&) {}
+
+template <typename T, typename... Args>
+inline void EncodeArgs(std::string& buf, std::string& types, const T& arg,
+                       const Args&... args)
+{
+    EncodeArg(buf, types, arg);
+    EncodeArgs(buf, types, args...);
+}
+} // ns details
+} // ns binlog
+} // ns pb
+
+#endif // PB_LOG_BINARY_FORMAT_H_
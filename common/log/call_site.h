@@ -0,0 +1,333 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-12 10:14:37
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-12 16:52:08
+*/
+
+#ifndef PB_LOG_CALL_SITE_H_
+#define PB_LOG_CALL_SITE_H_
+
+// Dynamic debug: every PB_DYNAMIC_LOG statement owns a static call site
+// descriptor with an atomic enabled flag. Sites are switched on and off at
+// runtime by file glob, function name or format substring, independent of
+// the logger level.
+//
+// Example:
+//
+// PB_DYNAMIC_DEBUG(logger, "conn {} state {}", id, state);
+// ...
+// pb::CallSiteFilter filter;
+// filter.file_glob = "*db/pool*";
+// pb::log::enable_call_sites(filter);
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "common_def.h"
+
+namespace pb
+{
+// selects call sites. empty fields (and line 0) match everything.
+// a file glob containing '/' is matched against the full __FILE__ path,
+// otherwise against its basename. supports '*' and '?'.
+struct CallSiteFilter
+{
+    std::string file_glob;
+    std::string function;
+    std::string format_substr;
+    int line = 0;
+};
+
+class CallSite
+{
+public:
+    enum State
+    {
+        kDisabled = 0,
+        kEnabled = 1,
+        kUnregistered = 2
+    };
+
+    // constexpr so that a function local static is constant initialized and
+    // the compiler emits no guard variable on the hot path
+    constexpr CallSite(const char* file, const char* function, int line,
+                       LevelEnum level) :
+        file_(file),
+        function_(function),
+        format_(nullptr),
+        line_(line),
+        level_(level),
+        id_(0),
+        state_(kUnregistered),
+        next_(nullptr) {}
+
+    CallSite(const CallSite&) = delete;
+    CallSite& operator=(const CallSite&) = delete;
+
+    // a registered, disabled site costs one relaxed load and one branch.
+    // the first execution registers the site and applies the stored rules.
+    bool Enabled(const char* format)
+    {
+        int state = state_.load(std::memory_order_relaxed);
+        if (state == kDisabled)
+        {
+            return false;
+        }
+        return state == kEnabled || _Register(format);
+    }
+
+    // id of the site, registering it on first use. for sites which are
+    // always on (PB_LOG_BIN), where the enabled state doesn't matter
+    unsigned Id(const char* format)
+    {
+        if (state_.load(std::memory_order_acquire) == kUnregistered)
+        {
+            _Register(format);
+        }
+        return id_;
+    }
+
+    // release: publishes id_ and format_ set by the registration
+    void set_enabled(bool enabled)
+    {
+        state_.store(enabled ? kEnabled : kDisabled, std::memory_order_release);
+    }
+
+    const char* file() const { return file_; }
+    const char* function() const { return function_; }
+    const char* format() const { return format_; }
+    int line() const { return line_; }
+    LevelEnum level() const { return level_; }
+    // registration order, starting at 1. 0 until the site first runs
+    unsigned id() const { return id_; }
+
+private:
+    friend class CallSiteRegistry;
+    bool _Register(const char* format);
+
+    const char* file_;
+    const char* function_;
+    const char* format_;
+    int line_;
+    LevelEnum level_;
+    unsigned id_;
+    std::atomic_int state_;
+    CallSite* next_;
+};
+
+// global table of the call sites executed so far.
+// registration and toggling take the mutex, the log path never does.
+class CallSiteRegistry
+{
+public:
+    static CallSiteRegistry& instance()
+    {
+        static CallSiteRegistry s_instance;
+        return s_instance;
+    }
+
+    CallSiteRegistry(const CallSiteRegistry&) = delete;
+    CallSiteRegistry& operator=(const CallSiteRegistry&) = delete;
+
+    // link the site into the table and return its initial state.
+    // sites registered after a toggle inherit it, so a filter naming code
+    // that has not run yet still takes effect.
+    bool Register(CallSite* site, const char* format)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (site->state_.load(std::memory_order_relaxed) != CallSite::kUnregistered)
+        {
+            return site->state_.load(std::memory_order_relaxed) == CallSite::kEnabled;
+        }
+        site->format_ = format;
+        site->id_ = ++site_count_;
+        site->next_ = head_;
+        head_ = site;
+
+        bool enabled = false;
+        for (const auto& rule : rules_)
+        {
+            if (Matches(rule.first, *site))
+            {
+                enabled = rule.second;
+            }
+        }
+        site->set_enabled(enabled);
+        return enabled;
+    }
+
+    // toggle every matching site and remember the rule for future sites.
+    // returns the number of registered sites that matched
+    std::size_t Set(const CallSiteFilter& filter, bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        _AddRule(filter, enabled);
+
+        std::size_t matched = 0;
+        for (CallSite* site = head_; site; site = site->next_)
+        {
+            if (Matches(filter, *site))
+            {
+                site->set_enabled(enabled);
+                ++matched;
+            }
+        }
+        return matched;
+    }
+
+    // visit the registered sites, e.g. to list them on an admin endpoint
+    template <class Func>
+    void ForEach(const Func& func)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (CallSite* site = head_; site; site = site->next_)
+        {
+            func(*site);
+        }
+    }
+
+    static bool Matches(const CallSiteFilter& filter, const CallSite& site)
+    {
+        if (filter.line && filter.line != site.line())
+        {
+            return false;
+        }
+        if (!filter.function.empty() && filter.function != site.function())
+        {
+            return false;
+        }
+        if (!filter.format_substr.empty()
+            && (!site.format()
+                || !std::strstr(site.format(), filter.format_substr.c_str())))
+        {
+            return false;
+        }
+        if (!filter.file_glob.empty())
+        {
+            const char* path = site.file();
+            if (filter.file_glob.find('/') == std::string::npos)
+            {
+                const char* slash = std::strrchr(path, '/');
+                path = slash ? slash + 1 : path;
+            }
+            return GlobMatch(filter.file_glob.c_str(), path);
+        }
+        return true;
+    }
+
+    // '*' matches any run of characters, '?' matches one character
+    static bool GlobMatch(const char* pattern, const char* str)
+    {
+        const char* star = nullptr;
+        const char* resume = nullptr;
+        while (*str)
+        {
+            if (*pattern == '?' || *pattern == *str)
+            {
+                ++pattern;
+                ++str;
+            }
+            else if (*pattern == '*')
+            {
+                star = pattern++;
+                resume = str;
+            }
+            else if (star)
+            {
+                pattern = star + 1;
+                str = ++resume;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while (*pattern == '*')
+        {
+            ++pattern;
+        }
+        return !*pattern;
+    }
+
+private:
+    CallSiteRegistry() : head_(nullptr), site_count_(0) {}
+
+    // a later rule with the same filter replaces the earlier one,
+    // so repeated toggling doesn't grow the list
+    void _AddRule(const CallSiteFilter& filter, bool enabled)
+    {
+        for (auto it = rules_.begin(); it != rules_.end(); ++it)
+        {
+            const CallSiteFilter& f = it->first;
+            if (f.file_glob == filter.file_glob && f.function == filter.function
+                && f.format_substr == filter.format_substr && f.line == filter.line)
+            {
+                rules_.erase(it);
+                break;
+            }
+        }
+        rules_.emplace_back(filter, enabled);
+    }
+
+    std::mutex mutex_;
+    CallSite* head_;
+    unsigned site_count_;
+    std::vector<std::pair<CallSiteFilter, bool>> rules_;
+};
+
+inline bool CallSite::_Register(const char* format)
+{
+    return CallSiteRegistry::instance().Register(this, format);
+}
+
+namespace log
+{
+// switch matching call sites on/off. returns the number of sites matched
+// so far; sites which have not run yet pick the setting up when they do.
+inline std::size_t enable_call_sites(const CallSiteFilter& filter)
+{
+    return CallSiteRegistry::instance().Set(filter, true);
+}
+
+inline std::size_t disable_call_sites(const CallSiteFilter& filter)
+{
+    return CallSiteRegistry::instance().Set(filter, false);
+}
+} // ns log
+} // ns pb
+
+// log through the given logger only when this call site is enabled.
+// the logger level is bypassed, like SPDLOG_DEBUG.
+#define PB_DYNAMIC_LOG(logger, level, format, ...) \
+    do \
+    { \
+        static pb::CallSite pb_call_site_(__FILE__, __func__, __LINE__, level); \
+        if (pb_call_site_.Enabled(format)) \
+        { \
+            (logger)->ForceLog(level, format, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define PB_DYNAMIC_DEBUG(logger, format, ...) \
+    PB_DYNAMIC_LOG(logger, pb::kDebug, format, ##__VA_ARGS__)
+
+#endif // PB_LOG_CALL_SITE_H_
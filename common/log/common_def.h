@@ -68,7 +68,7 @@ enum LevelEnum
     kOff = 7
 };
 
-static const char* level_names[] {"trace", "debug", "info", "notice", "warning,"
+static const char* level_names[] {"trace", "debug", "info", "notice", "warning",
                                   "error", "critical", "off"};
 static const char* short_level_names[] {"T", "D", "I", "N", "W", "E", "C", "O"};
 
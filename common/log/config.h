@@ -0,0 +1,351 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-19 09:47:12
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-19 16:20:38
+*/
+
+#ifndef PB_LOG_CONFIG_H_
+#define PB_LOG_CONFIG_H_
+
+// Logging configuration file. One "key = value" per line, lines starting
+// with '#' are comments (a '#' after a value is part of the value):
+//
+// # root level and pattern
+// level = info
+// pattern = [%Y-%m-%d %H:%M:%S.%e] [%n] [%l] %v
+//
+// # async mode for the loggers created from now on. queue_size is a power
+// # of 2, or 0 for sync mode. overflow is block or discard
+// async.queue_size = 8192
+// async.overflow = block
+//
+// # levels apply to the subtree, patterns to the logger only.
+// # sinks create the logger if it doesn't exist yet, and replace its sinks
+// # when they differ from the ones the file gave it last
+// logger.db.level = debug
+// logger.db.pool.pattern = %v
+// logger.db.sinks = stdout, rotating:/var/log/db:10485760:5
+//
+// sinks: stdout, stderr, color[:stderr] (colored on a terminal),
+// file:<path>, rotating:<path>:<max size>:<max files>,
+// daily:<path>:<hour>:<minute>, syslog[:<ident>]
+//
+// The file is authoritative for levels: levels missing from it go back to
+// the default (info, or inherited). Patterns and async settings are only
+// changed when present.
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common_def.h"
+#include "sinks/color_console_sink.h"
+#include "sinks/file_sink.h"
+#include "sinks/stdout_sink.h"
+#ifdef __linux__
+#include "sinks/syslog_sink.h"
+#endif
+
+namespace pb
+{
+struct LoggerConfig
+{
+    LoggerConfig() : has_level(false), level(kInfo) {}
+
+    bool has_level;
+    LevelEnum level;
+    // empty: keep the logger's formatter
+    std::string pattern;
+    // sink specs, see the top of the file
+    std::vector<std::string> sinks;
+};
+
+struct LogConfig
+{
+    LogConfig() :
+        level(kInfo),
+        has_async(false),
+        async_queue_size(0),
+        overflow_policy(AsyncOverflowPolicy::kBlockRetry) {}
+
+    // parse a configuration. throws SimpleException naming the line on error
+    static LogConfig Parse(const std::string& text);
+    static LogConfig Load(const std::string& path);
+    // read the whole file. throws if it can't be opened
+    static std::string ReadFile(const std::string& path);
+    // create the sink described by spec. throws on a bad spec
+    static sink_ptr MakeSink(const std::string& spec);
+
+    LevelEnum level;
+    std::string pattern;
+    bool has_async;
+    std::size_t async_queue_size;
+    AsyncOverflowPolicy overflow_policy;
+    std::map<std::string, LoggerConfig> loggers;
+};
+
+namespace details
+{
+inline std::string Trim(const std::string& s)
+{
+    const char* ws = " \t\r\n";
+    std::size_t begin = s.find_first_not_of(ws);
+    if (begin == std::string::npos)
+    {
+        return std::string();
+    }
+    return s.substr(begin, s.find_last_not_of(ws) - begin + 1);
+}
+
+inline bool ParseLevel(const std::string& name, LevelEnum& level)
+{
+    static const char* const names[] = {"trace", "debug", "info", "notice",
+                                        "warning", "error", "critical", "off"};
+    for (int i = kTrace; i <= kOff; ++i)
+    {
+        if (name == names[i])
+        {
+            level = static_cast<LevelEnum>(i);
+            return true;
+        }
+    }
+    if (name == "warn")
+    {
+        level = kWarning;
+        return true;
+    }
+    return false;
+}
+
+inline bool ParseNumber(const std::string& s, std::size_t& n)
+{
+    if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+    n = static_cast<std::size_t>(std::strtoull(s.c_str(), nullptr, 10));
+    return true;
+}
+
+// split "a:b:c" into count fields, the first one taking any extra ':'
+// (paths may contain them)
+inline bool SplitSpec(const std::string& s, std::size_t count,
+                      std::vector<std::string>& fields)
+{
+    fields.assign(count, std::string());
+    std::size_t end = s.size();
+    for (std::size_t i = count - 1; i > 0; --i)
+    {
+        std::size_t colon = s.rfind(':', end ? end - 1 : 0);
+        if (colon == std::string::npos || !end)
+        {
+            return false;
+        }
+        fields[i] = s.substr(colon + 1, end - colon - 1);
+        end = colon;
+    }
+    fields[0] = s.substr(0, end);
+    return !fields[0].empty();
+}
+} // ns details
+} // ns pb
+
+inline pb::LogConfig pb::LogConfig::Parse(const std::string& text)
+{
+    LogConfig config;
+    std::istringstream in(text);
+    std::string line;
+    for (int line_no = 1; std::getline(in, line); ++line_no)
+    {
+        line = details::Trim(line);
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::size_t eq = line.find('=');
+        if (eq == std::string::npos)
+        {
+            throw SimpleException(fmt::format(
+                "log config line {}: expected key = value", line_no));
+        }
+        std::string key = details::Trim(line.substr(0, eq));
+        std::string value = details::Trim(line.substr(eq + 1));
+        auto bad_value = [&]()
+        {
+            return SimpleException(fmt::format(
+                "log config line {}: bad value '{}' for {}", line_no, value, key));
+        };
+
+        if (key == "level")
+        {
+            if (!details::ParseLevel(value, config.level))
+            {
+                throw bad_value();
+            }
+        }
+        else if (key == "pattern")
+        {
+            config.pattern = value;
+        }
+        else if (key == "async.queue_size")
+        {
+            std::size_t& n = config.async_queue_size;
+            if (!details::ParseNumber(value, n) || (n & (n - 1)))
+            {
+                throw bad_value();
+            }
+            config.has_async = true;
+        }
+        else if (key == "async.overflow")
+        {
+            if (value == "block")
+            {
+                config.overflow_policy = AsyncOverflowPolicy::kBlockRetry;
+            }
+            else if (value == "discard")
+            {
+                config.overflow_policy = AsyncOverflowPolicy::kDiscardLogMsg;
+            }
+            else
+            {
+                throw bad_value();
+            }
+            config.has_async = true;
+        }
+        else if (!key.compare(0, 7, "logger."))
+        {
+            std::size_t dot = key.rfind('.');
+            std::string name = key.substr(7, dot > 7 ? dot - 7 : 0);
+            std::string field = key.substr(dot + 1);
+            if (name.empty())
+            {
+                throw SimpleException(fmt::format(
+                    "log config line {}: expected logger.<name>.<setting>", line_no));
+            }
+            LoggerConfig& logger = config.loggers[name];
+            if (field == "level")
+            {
+                if (!details::ParseLevel(value, logger.level))
+                {
+                    throw bad_value();
+                }
+                logger.has_level = true;
+            }
+            else if (field == "pattern")
+            {
+                logger.pattern = value;
+            }
+            else if (field == "sinks")
+            {
+                std::istringstream specs(value);
+                std::string spec;
+                logger.sinks.clear();
+                while (std::getline(specs, spec, ','))
+                {
+                    spec = details::Trim(spec);
+                    if (spec.empty())
+                    {
+                        throw bad_value();
+                    }
+                    logger.sinks.push_back(spec);
+                }
+            }
+            else
+            {
+                throw SimpleException(fmt::format(
+                    "log config line {}: unknown setting '{}'", line_no, key));
+            }
+        }
+        else
+        {
+            throw SimpleException(fmt::format(
+                "log config line {}: unknown setting '{}'", line_no, key));
+        }
+    }
+    return config;
+}
+
+inline std::string pb::LogConfig::ReadFile(const std::string& path)
+{
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    if (!in)
+    {
+        throw SimpleException("failed opening log config " + path);
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+inline pb::LogConfig pb::LogConfig::Load(const std::string& path)
+{
+    return Parse(ReadFile(path));
+}
+
+inline pb::sink_ptr pb::LogConfig::MakeSink(const std::string& spec)
+{
+    std::size_t colon = spec.find(':');
+    std::string type = spec.substr(0, colon);
+    std::string args = colon == std::string::npos ? std::string()
+                                                  : spec.substr(colon + 1);
+    std::vector<std::string> fields;
+    std::size_t a = 0;
+    std::size_t b = 0;
+
+    if (type == "stdout" && args.empty())
+    {
+        return std::make_shared<StdoutSinkMt>();
+    }
+    if (type == "stderr" && args.empty())
+    {
+        return std::make_shared<StderrSinkMt>();
+    }
+    if (type == "color" && (args.empty() || args == "stderr"))
+    {
+        return std::make_shared<ColorConsoleSinkMt>(args.empty() ? 1 : 2);
+    }
+    if (type == "file" && !args.empty())
+    {
+        return std::make_shared<SimpleFileSinkMt>(args);
+    }
+    if (type == "rotating" && details::SplitSpec(args, 3, fields)
+        && details::ParseNumber(fields[1], a) && details::ParseNumber(fields[2], b))
+    {
+        return std::make_shared<RotatingFileSinkMt>(fields[0], "txt", a, b);
+    }
+    if (type == "daily" && details::SplitSpec(args, 3, fields)
+        && details::ParseNumber(fields[1], a) && details::ParseNumber(fields[2], b))
+    {
+        return std::make_shared<DailyFileSinkMt>(fields[0], "txt",
+                                                 static_cast<int>(a),
+                                                 static_cast<int>(b));
+    }
+#ifdef __linux__
+    if (type == "syslog")
+    {
+        return std::make_shared<SyslogSink>(args);
+    }
+#endif
+    throw SimpleException("bad log sink '" + spec + "'");
+}
+
+#endif // PB_LOG_CONFIG_H_
@@ -0,0 +1,205 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-19 14:05:31
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-19 18:12:09
+*/
+
+#ifndef PB_LOG_CONFIG_WATCHER_H_
+#define PB_LOG_CONFIG_WATCHER_H_
+
+#ifdef __linux__
+
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <thread>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "common_def.h"
+#include "config.h"
+#include "registry.h"
+
+namespace pb
+{
+// re-applies a configuration file whenever it changes.
+// the directory is watched rather than the file, so editors and deploy
+// tools which replace the file (write to a temp file and rename) are seen
+// too. only finished writes and renames count: a file just created is still
+// empty, and an empty configuration is valid. a change which fails to parse
+// or apply is reported to the error handler and the configuration in effect
+// stays as it is.
+//
+// Example:
+//
+// pb::ConfigWatcher watcher("/etc/myapp/log.conf", [](const std::string& e)
+// {
+//     std::cerr << e << std::endl;
+// });
+class ConfigWatcher
+{
+public:
+    using ErrorHandler = std::function<void(const std::string&)>;
+
+    // applies the file once before returning (throws if that fails),
+    // then starts the watcher thread
+    explicit ConfigWatcher(const std::string& path,
+                           const ErrorHandler& on_error = nullptr);
+    // stops and joins the watcher thread
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+private:
+    void _WatchLoop();
+    // true if some event in buf is about the watched file
+    bool _Touched(const char* buf, ssize_t size) const;
+    void _Reload();
+    void _Close();
+
+    std::string path_;
+    std::string dir_;
+    std::string file_;
+    ErrorHandler on_error_;
+    // text of the configuration in effect, to skip reloads of an unchanged
+    // file (one save often makes several events)
+    std::string text_;
+    int inotify_fd_;
+    // written by the dtor to wake the thread up
+    int stop_pipe_[2];
+    std::thread thread_;
+};
+} // ns pb
+
+inline pb::ConfigWatcher::ConfigWatcher(const std::string& path,
+                                        const ErrorHandler& on_error) :
+    path_(path),
+    on_error_(on_error),
+    inotify_fd_(-1)
+{
+    stop_pipe_[0] = stop_pipe_[1] = -1;
+    std::size_t slash = path_.rfind('/');
+    dir_ = slash == std::string::npos ? "." : path_.substr(0, slash ? slash : 1);
+    file_ = slash == std::string::npos ? path_ : path_.substr(slash + 1);
+
+    text_ = LogConfig::ReadFile(path_);
+    Registry::instance().Apply(LogConfig::Parse(text_));
+
+    inotify_fd_ = ::inotify_init1(IN_CLOEXEC);
+    if (inotify_fd_ == -1 || ::pipe(stop_pipe_) == -1
+        || ::inotify_add_watch(inotify_fd_, dir_.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+    {
+        int err = errno;
+        _Close();
+        throw SimpleException(fmt::format("failed watching {}: {}",
+                                          dir_, std::strerror(err)));
+    }
+    thread_ = std::thread(&ConfigWatcher::_WatchLoop, this);
+}
+
+inline pb::ConfigWatcher::~ConfigWatcher()
+{
+    char c = 0;
+    while (::write(stop_pipe_[1], &c, 1) == -1 && errno == EINTR);
+    thread_.join();
+    _Close();
+}
+
+inline void pb::ConfigWatcher::_WatchLoop()
+{
+    alignas(struct inotify_event) char buf[4096];
+    pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+    for (;;)
+    {
+        if (::poll(fds, 2, -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents)
+        {
+            return;
+        }
+        ssize_t size = ::read(inotify_fd_, buf, sizeof(buf));
+        if (size > 0 && _Touched(buf, size))
+        {
+            _Reload();
+        }
+    }
+}
+
+inline bool pb::ConfigWatcher::_Touched(const char* buf, ssize_t size) const
+{
+    for (const char* p = buf; p < buf + size;)
+    {
+        const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+        if (event->len && file_ == event->name)
+        {
+            return true;
+        }
+        p += sizeof(inotify_event) + event->len;
+    }
+    return false;
+}
+
+inline void pb::ConfigWatcher::_Reload()
+{
+    try
+    {
+        std::string text = LogConfig::ReadFile(path_);
+        if (text == text_)
+        {
+            return;
+        }
+        Registry::instance().Apply(LogConfig::Parse(text));
+        text_.swap(text);
+    }
+    catch (const std::exception& ex)
+    {
+        if (on_error_)
+        {
+            on_error_(std::string("log config reload: ") + ex.what());
+        }
+    }
+}
+
+inline void pb::ConfigWatcher::_Close()
+{
+    for (int fd : {inotify_fd_, stop_pipe_[0], stop_pipe_[1]})
+    {
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+    }
+    inotify_fd_ = stop_pipe_[0] = stop_pipe_[1] = -1;
+}
+
+#endif // __linux__
+
+#endif // PB_LOG_CONFIG_WATCHER_H_
@@ -0,0 +1,230 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-16 10:21:07
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-16 15:40:52
+*/
+
+#ifndef PB_LOG_CONTEXT_H_
+#define PB_LOG_CONTEXT_H_
+
+// Thread local diagnostic context (MDC). Key/value pairs pushed with
+// pb::log::ScopedContext are pre-rendered once as "key=value key2=value2"
+// and attached to every message logged by the thread while in scope.
+//
+// Example:
+//
+// pb::log::ScopedContext req("req", request_id);
+// pb::log::ScopedContext tenant("tenant", tenant_id);
+// logger->info("started"); // %X renders "req=42 tenant=acme"
+
+#include <cstdint>
+#include <cstring>
+#include <common/util/format.h>
+
+namespace pb
+{
+// one key/value pair, as offsets into the rendered context text
+struct ContextField
+{
+    std::uint16_t key_offset;
+    std::uint16_t key_size;
+    std::uint16_t value_offset;
+    std::uint16_t value_size;
+};
+
+// view of a diagnostic context. only valid while the message carrying it
+// is being dispatched
+struct LogContext
+{
+    LogContext() : data(nullptr), size(0), fields(nullptr), field_count(0) {}
+
+    bool empty() const { return size == 0; }
+
+    const char* data;
+    std::size_t size;
+    const ContextField* fields;
+    std::size_t field_count;
+};
+
+// the calling thread's context stack. fixed size so push and pop never
+// allocate. a pair which doesn't fit is dropped (and its pop ignored).
+class ContextStack
+{
+public:
+    static const std::size_t kCapacity = 512;
+    static const std::size_t kMaxFields = 16;
+
+    static ContextStack& Local()
+    {
+        static thread_local ContextStack t_stack;
+        return t_stack;
+    }
+
+    // returns false if the pair didn't fit
+    bool Push(fmt::StringRef key, fmt::StringRef value)
+    {
+        std::size_t sep = size_ ? 1 : 0;
+        std::size_t needed = sep + key.size() + 1 + value.size();
+        if (dropped_ || count_ == kMaxFields || size_ + needed > kCapacity)
+        {
+            ++dropped_;
+            return false;
+        }
+        if (sep)
+        {
+            data_[size_++] = ' ';
+        }
+        ContextField& field = fields_[count_++];
+        field.key_offset = static_cast<std::uint16_t>(size_);
+        field.key_size = static_cast<std::uint16_t>(key.size());
+        std::memcpy(data_ + size_, key.c_str(), key.size());
+        size_ += key.size();
+        data_[size_++] = '=';
+        field.value_offset = static_cast<std::uint16_t>(size_);
+        field.value_size = static_cast<std::uint16_t>(value.size());
+        std::memcpy(data_ + size_, value.c_str(), value.size());
+        size_ += value.size();
+        return true;
+    }
+
+    void Pop()
+    {
+        if (dropped_)
+        {
+            --dropped_;
+            return;
+        }
+        if (count_)
+        {
+            --count_;
+            // drop the pair and the separating space before it
+            size_ = count_ ? fields_[count_].key_offset - 1 : 0;
+        }
+    }
+
+    LogContext View() const
+    {
+        LogContext ctx;
+        if (size_)
+        {
+            ctx.data = data_;
+            ctx.size = size_;
+            ctx.fields = fields_;
+            ctx.field_count = count_;
+        }
+        return ctx;
+    }
+
+private:
+    ContextStack() : size_(0), count_(0), dropped_(0) {}
+
+    char data_[kCapacity];
+    std::size_t size_;
+    ContextField fields_[kMaxFields];
+    std::size_t count_;
+    std::size_t dropped_;
+};
+
+// owning copy of a context, for messages which outlive the logging call
+// (async queue, backtrace ring). the text is kept inline, as in the
+// ContextStack it comes from, so taking or copying a snapshot never
+// allocates and copies only the used part: the fields and the text.
+class ContextSnapshot
+{
+public:
+    ContextSnapshot() : size_(0), count_(0) {}
+
+    ContextSnapshot(const ContextSnapshot& other) : size_(0), count_(0)
+    {
+        Assign(other.View());
+    }
+
+    ContextSnapshot& operator=(const ContextSnapshot& other)
+    {
+        if (this != &other)
+        {
+            Assign(other.View());
+        }
+        return *this;
+    }
+
+    void Assign(const LogContext& ctx)
+    {
+        count_ = ctx.field_count;
+        size_ = count_ ? ctx.size : 0;
+        if (!count_)
+        {
+            return;
+        }
+        std::memcpy(txt_, ctx.data, size_);
+        std::memcpy(fields_, ctx.fields, count_ * sizeof(ContextField));
+    }
+
+    LogContext View() const
+    {
+        LogContext ctx;
+        if (count_)
+        {
+            ctx.data = txt_;
+            ctx.size = size_;
+            ctx.fields = fields_;
+            ctx.field_count = count_;
+        }
+        return ctx;
+    }
+
+private:
+    char txt_[ContextStack::kCapacity];
+    std::size_t size_;
+    ContextField fields_[ContextStack::kMaxFields];
+    std::size_t count_;
+};
+
+namespace log
+{
+// pushes key=value on the thread's context for the lifetime of the object.
+// the value is rendered once here with the usual {} formatting.
+class ScopedContext
+{
+public:
+    template <typename T>
+    ScopedContext(const char* key, const T& value)
+    {
+        fmt::MemoryWriter w;
+        w.write("{}", value);
+        ContextStack::Local().Push(key, fmt::StringRef(w.data(), w.size()));
+    }
+
+    ScopedContext(const char* key, const char* value)
+    {
+        ContextStack::Local().Push(key, value);
+    }
+
+    ~ScopedContext()
+    {
+        ContextStack::Local().Pop();
+    }
+
+    ScopedContext(const ScopedContext&) = delete;
+    ScopedContext& operator=(const ScopedContext&) = delete;
+};
+} // ns log
+} // ns pb
+
+#endif // PB_LOG_CONTEXT_H_
@@ -0,0 +1,158 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-13 10:34:12
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-13 14:47:39
+*/
+
+#ifndef PB_LOG_DISPATCH_H_
+#define PB_LOG_DISPATCH_H_
+
+#include <vector>
+#include <algorithm>
+#include "common_def.h"
+#include "formatter.h"
+#include "log_message.h"
+#include "sinks/sink.h"
+
+namespace pb
+{
+namespace details
+{
+inline formatter* SinkFormatter(const Sink& sink, formatter* default_formatter)
+{
+    formatter* f = sink.formatter().get();
+    return f ? f : default_formatter;
+}
+
+// true if the sink takes formatted text for this message from formatter f
+inline bool InFormatterGroup(const Sink& sink, const LogMessage& msg,
+                             formatter* f, formatter* default_formatter)
+{
+    return sink.ShouldLog(msg.level) && sink.UsesFormatted()
+        && SinkFormatter(sink, default_formatter) == f;
+}
+} // ns details
+
+// hand a message to the sinks, grouping them by formatter so each distinct
+// formatter runs at most once per message. sinks below their level are
+// skipped before any formatting, and sinks which don't use the formatted
+// text get the message as is.
+// sinks without a formatter of their own share default_formatter.
+inline void DispatchMsg(LogMessage& msg, const std::vector<sink_ptr>& sinks,
+                        formatter* default_formatter)
+{
+    const std::size_t count = sinks.size();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Sink& sink = *sinks[i];
+        if (!sink.ShouldLog(msg.level))
+        {
+            continue;
+        }
+        if (!sink.UsesFormatted())
+        {
+            sink.Log(msg);
+            continue;
+        }
+
+        // sinks sharing a formatter with an earlier sink were served with it
+        formatter* f = details::SinkFormatter(sink, default_formatter);
+        bool served = false;
+        for (std::size_t j = 0; j < i && !served; ++j)
+        {
+            served = details::InFormatterGroup(*sinks[j], msg, f, default_formatter);
+        }
+        if (served)
+        {
+            continue;
+        }
+
+        msg.formatted.clear();
+        f->format(msg);
+        sink.Log(msg);
+        for (std::size_t j = i + 1; j < count; ++j)
+        {
+            if (details::InFormatterGroup(*sinks[j], msg, f, default_formatter))
+            {
+                sinks[j]->Log(msg);
+            }
+        }
+    }
+}
+
+// batch version of DispatchMsg: every sink gets all the records in a single
+// LogBatch() call. a formatter formats the records which at least one sink
+// of its group accepts; sinks skip records below their own level.
+inline void DispatchBatch(LogMessage* const* msgs, std::size_t msg_count,
+                          const std::vector<sink_ptr>& sinks,
+                          formatter* default_formatter)
+{
+    const std::size_t count = sinks.size();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Sink& sink = *sinks[i];
+        if (!sink.UsesFormatted())
+        {
+            sink.LogBatch(msgs, msg_count);
+            continue;
+        }
+
+        formatter* f = details::SinkFormatter(sink, default_formatter);
+        bool served = false;
+        int group_level = sink.level();
+        for (std::size_t j = 0; j < count; ++j)
+        {
+            if (j == i || !sinks[j]->UsesFormatted()
+                || details::SinkFormatter(*sinks[j], default_formatter) != f)
+            {
+                continue;
+            }
+            if (j < i)
+            {
+                served = true;
+                break;
+            }
+            group_level = std::min<int>(group_level, sinks[j]->level());
+        }
+        if (served)
+        {
+            continue;
+        }
+
+        for (std::size_t m = 0; m < msg_count; ++m)
+        {
+            msgs[m]->formatted.clear();
+            if (msgs[m]->level >= group_level)
+            {
+                f->format(*msgs[m]);
+            }
+        }
+        for (std::size_t j = i; j < count; ++j)
+        {
+            if (sinks[j]->UsesFormatted()
+                && details::SinkFormatter(*sinks[j], default_formatter) == f)
+            {
+                sinks[j]->LogBatch(msgs, msg_count);
+            }
+        }
+    }
+}
+} // ns pb
+
+#endif // PB_LOG_DISPATCH_H_
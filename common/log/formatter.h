@@ -0,0 +1,40 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-13 10:02:55
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-13 10:31:20
+*/
+
+#ifndef PB_LOG_FORMATTER_H_
+#define PB_LOG_FORMATTER_H_
+
+#include "log_message.h"
+
+namespace pb
+{
+// renders a message (raw text, level, time, logger name) into
+// LogMessage::formatted. formatted is empty when format() is called.
+class formatter
+{
+public:
+    virtual ~formatter() {}
+    virtual void format(LogMessage& msg) = 0;
+};
+} // ns pb
+
+#endif // PB_LOG_FORMATTER_H_
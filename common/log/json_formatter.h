@@ -0,0 +1,99 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-23 14:02:36
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-23 18:40:11
+*/
+
+#ifndef PB_LOG_JSON_FORMATTER_H_
+#define PB_LOG_JSON_FORMATTER_H_
+
+// One JSON object per line:
+//
+// {"ts":"2015-03-23T14:02:36.123+08:00","level":"info","logger":"db",
+//  "thread":1234,"msg":"connected","req":"42","tenant":"acme"}
+//
+// The diagnostic context (see context.h) is written as top level string
+// fields after "msg", in push order. A context key equal to one of the
+// fixed keys makes a duplicate key, which most readers resolve to the last
+// one. Strings are escaped as they are copied (see util/escape.h); bytes
+// >= 0x80 are copied as is, so the output is as valid UTF-8 as the input.
+//
+// Example:
+//
+// logger->set_formatter(std::make_shared<pb::json_formatter>());
+
+#include <common/util/escape.h>
+#include <common/util/format.h>
+#include <common/util/os_spec.h>
+#include "common_def.h"
+#include "formatter.h"
+#include "log_message.h"
+#include "pattern_formatter.h"
+
+namespace pb
+{
+class json_formatter : public formatter
+{
+public:
+    json_formatter();
+    json_formatter(const json_formatter&) = delete;
+    json_formatter& operator=(const json_formatter&) = delete;
+
+    void format(LogMessage& msg) override;
+
+private:
+    // the fixed text up to the level name. a pattern, so the timestamp is
+    // rendered once per second and thread like the text formatter's
+    pattern_formatter prefix_;
+};
+} // ns pb
+
+inline pb::json_formatter::json_formatter() :
+    prefix_("{\"ts\":\"%Y-%m-%dT%H:%M:%S.%e%z\",\"level\":\"", false)
+{
+}
+
+inline void pb::json_formatter::format(LogMessage& msg)
+{
+    LogWriter& w = msg.formatted;
+    prefix_.format(msg);
+    // level names need no escaping
+    w << to_str(msg.level);
+    details::Append(w, "\",\"logger\":\"", 12);
+    JsonEscape(w, msg.logger_name.data(), msg.logger_name.size());
+    details::Append(w, "\",\"thread\":", 11);
+    w << msg.thread_id;
+    details::Append(w, ",\"msg\":\"", 8);
+    JsonEscape(w, msg.raw.data(), msg.raw.size());
+    w << '"';
+    const LogContext& ctx = msg.context;
+    for (std::size_t i = 0; i < ctx.field_count; ++i)
+    {
+        const ContextField& field = ctx.fields[i];
+        details::Append(w, ",\"", 2);
+        JsonEscape(w, ctx.data + field.key_offset, field.key_size);
+        details::Append(w, "\":\"", 3);
+        JsonEscape(w, ctx.data + field.value_offset, field.value_size);
+        w << '"';
+    }
+    w << '}';
+    details::Append(w, os::eol(), os::eol_size());
+}
+
+#endif // PB_LOG_JSON_FORMATTER_H_
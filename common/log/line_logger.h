@@ -26,18 +26,25 @@
 #include <type_traits>
 #include "common_def.h"
 #include "logger.h"
+#include "message_pool.h"
 
 namespace pb
 {
 // line logger class - aggregates operator << calls to fast ostream
-// and logs upon destruction
+// and logs upon destruction.
+// the message buffers are borrowed from the thread's MessagePool and returned
+// on destruction, a disabled line logger doesn't touch the pool at all.
+// a forced line logger (ForceLog) always reaches the sinks, otherwise
+// messages below the logger threshold only go to its backtrace.
 class LineLogger
 {
 public:
-    LineLogger(Logger* callback_logger, LevelEnum msg_level, bool enabled) :
+    LineLogger(Logger* callback_logger, LevelEnum msg_level, bool enabled,
+               bool forced = false) :
         callback_logger_(callback_logger),
-        log_msg_(msg_level),
-        enabled_(enabled) {}
+        log_msg_(enabled ? MessagePool::Acquire(msg_level) : nullptr),
+        enabled_(enabled),
+        forced_(forced) {}
 
     // no copy intended. only move
     LineLogger(const LineLogger& other) = delete;
@@ -46,9 +53,11 @@ public:
 
     LineLogger(LineLogger&& other) :
         callback_logger_(other.callback_logger_),
-        log_msg_(std::move(other.log_msg_)),
-        enabled_(other.enabled_)
+        log_msg_(other.log_msg_),
+        enabled_(other.enabled_),
+        forced_(other.forced_)
     {
+        other.log_msg_ = nullptr;
         other.Disable();
     }
 
@@ -57,9 +66,15 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.logger_name = callback_logger_->name();
-            log_msg_.time = os::now();
-            callback_logger_->_LogMsg(log_msg_);
+            log_msg_->logger_name = callback_logger_->name();
+            log_msg_->time = os::now();
+            log_msg_->thread_id = os::thread_id();
+            log_msg_->context = ContextStack::Local().View();
+            callback_logger_->_SubmitMsg(*log_msg_, forced_);
+        }
+        if (log_msg_)
+        {
+            MessagePool::Release(log_msg_);
         }
     }
 
@@ -68,7 +83,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
     }
 
@@ -81,7 +96,15 @@ public:
         }
         try
         {
-            log_msg_.raw.write(fmt, args...);
+            std::size_t max_size = callback_logger_->max_message_size();
+            if (max_size)
+            {
+                _WriteCapped(max_size, fmt, args...);
+            }
+            else
+            {
+                log_msg_->raw.write(fmt, args...);
+            }
         }
         catch (const fmt::FormatError& e)
         {
@@ -96,7 +119,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -105,7 +128,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -114,7 +137,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -123,7 +146,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -132,7 +155,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -141,7 +164,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -150,7 +173,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -159,7 +182,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -168,7 +191,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -177,7 +200,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -186,7 +209,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -195,7 +218,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw << what;
+            _Put(what);
         }
         return *this;
     }
@@ -206,7 +229,7 @@ public:
     {
         if (enabled_)
         {
-            log_msg_.raw.write("{}", what);
+            write("{}", what);
         }
         return *this;
     }
@@ -216,9 +239,55 @@ public:
         enabled_ = false;
     }
 private:
+    template <typename T>
+    void _Put(const T& what)
+    {
+        std::size_t max_size = callback_logger_->max_message_size();
+        if (max_size)
+        {
+            _WriteCapped(max_size, "{}", what);
+        }
+        else
+        {
+            log_msg_->raw << what;
+        }
+    }
+
+    // format straight into the message's storage through a fixed writer,
+    // which drops what goes past max_size instead of growing the message.
+    // the writer gets the room the storage already has; only output which
+    // doesn't fit there grows it, as far as the output needs, and is
+    // formatted again
+    template <typename... Args>
+    void _WriteCapped(std::size_t max_size, const char* fmt,
+                      const Args&... args)
+    {
+        fmt::internal::Buffer<char>& raw = log_msg_->raw.buffer();
+        std::size_t size = raw.size();
+        if (size >= max_size)
+        {
+            return;
+        }
+        std::size_t room = (std::min)(raw.capacity(), max_size) - size;
+        fmt::FixedWriter w(&raw[0] + size, room);
+        w.write(fmt, args...);
+        std::size_t full_size = w.full_size();
+        if (full_size > room && room < max_size - size)
+        {
+            room = (std::min)(full_size, max_size - size);
+            raw.reserve(size + room);
+            fmt::FixedWriter grown(&raw[0] + size, room);
+            grown.write(fmt, args...);
+            raw.resize(size + grown.size());
+            return;
+        }
+        raw.resize(size + w.size());
+    }
+
     Logger* callback_logger_;
-    LogMessage log_msg_;
+    LogMessage* log_msg_;
     bool enabled_;
+    bool forced_;
 };
 } // ns pb
 #endif // PB_LOG_LINE_LOGGER_H_
@@ -25,20 +25,32 @@
 
 #include "common_def.h"
 #include "logger.h"
+#include "log_batch.h"
+#include "call_site.h"
+#include "registry.h"
 
 namespace pb
 {
 namespace log
 {
 // Return an existing logger or nullptr if a logger with such name
-// doesn't exist.
+// doesn't exist. Lock free; a name given as a string literal (or a
+// LoggerKey constant) is hashed at compile time.
 // Examples:
 //
 // pb::log::get("mylog")->info("Hello");
 // auto logger = pb::log::get("mylog");
 // logger.info("This is another message" , x, y, z);
 // logger.info() << "This is another message" << x << y << z;
-std::shared_ptr<Logger> get(const std::string& name);
+std::shared_ptr<Logger> get(const LoggerKey& name);
+
+// Like get, without the shared_ptr refcount: the handle is a plain pointer
+// to the registry owned logger, valid until exit even if the logger is
+// dropped. Cache it where the logger is used:
+//
+// static const pb::LoggerHandle s_log = pb::log::handle("db.query");
+// s_log->info("query took {}us", us);
+LoggerHandle handle(const LoggerKey& name);
 
 //
 // Set global formatting
@@ -50,7 +62,19 @@ void set_formatter(formatter_ptr f);
 //
 // Set global logging level for
 //
-void set_level(level::level_enum log_level);
+void set_level(LevelEnum log_level);
+
+//
+// Set the level of a logger and of its descendants in the dotted name
+// hierarchy. Descendants with a level of their own keep it.
+// Example:
+//
+// pb::log::set_level("db", pb::kDebug);        // db.query, db.pool.conn...
+// pb::log::set_level("db.pool", pb::kWarning); // except db.pool.*
+// pb::log::reset_level("db.pool");             // inherit from db again
+//
+void set_level(const std::string& logger_name, LevelEnum log_level);
+void reset_level(const std::string& logger_name);
 
 //
 // Turn on async mode (off by default) and set the queue size for each
@@ -77,6 +101,14 @@ void set_async_mode(size_t queue_size,
 // Turn off async mode
 void set_sync_mode();
 
+//
+// Load levels, patterns, sinks and async settings from a configuration file
+// (format in config.h). Throws, changing nothing, if the file is invalid.
+// To re-apply the file whenever it changes, keep a pb::ConfigWatcher
+// (config_watcher.h, linux only) alive instead.
+//
+void load_config(const std::string& path);
+
 //
 // Create multi/single threaded rotating file logger
 //
@@ -169,15 +201,39 @@ std::shared_ptr<Logger> create(const std::string& logger_name, const Args&...);
 #define SPDLOG_DEBUG(logger, ...)
 #endif
 
+//
+// Runtime switchable debug statements (see call_site.h). Disabled sites cost
+// a single load and branch, enable them by file glob, function or format:
+//
+// PB_DYNAMIC_DEBUG(my_logger, "conn {} state {}", id, state);
+// pb::CallSiteFilter filter;
+// filter.function = "OnConnect";
+// pb::log::enable_call_sites(filter);
+//
+
+//
+// Binary logging (see sinks/binary_file_sink.h): records are written
+// unformatted, as call site id and argument bytes, and turned into text
+// offline by tools/binlog_decoder.cc:
+//
+// auto bin = std::make_shared<pb::BinaryFileSinkMt>("trade.binlog", "trade");
+// PB_LOG_BIN(bin, pb::kInfo, "order {} filled {}", id, qty);
+//
 
 
-// Drop the reference to the given logger
+
+// Drop the given logger from the registry and close it: queued messages
+// are written, then its async worker and its sinks are released (closing
+// the files no other logger writes to). Handles and shared_ptrs to it stay valid and log nothing.
+// Don't drop a logger from within one of its own sinks
 void drop(const std::string &name);
 
-// Drop all references
+// Drop all loggers, see drop
 void drop_all();
 
 } // ns log
 } // ns pb
 
+#include "log_impl.h"
+
 #endif // PB_LOG_LOG_H_
@@ -0,0 +1,150 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-16 17:02:26
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-17 11:28:03
+*/
+
+#ifndef PB_LOG_LOG_BATCH_H_
+#define PB_LOG_LOG_BATCH_H_
+
+#include <deque>
+#include <vector>
+#include "common_def.h"
+#include "logger.h"
+#include "context.h"
+
+namespace pb
+{
+// collects many records and hands them to the logger's sinks together:
+// one dispatch, one lock per sink and (for file sinks) one writev().
+// the records stay contiguous in the output.
+// committed on destruction, or earlier with Commit(). the builder can be
+// reused after a commit and keeps its buffers.
+//
+// Example:
+//
+// pb::LogBatch batch(logger.get());
+// for (const auto& route : table)
+// {
+//     batch.Add(pb::kInfo, "{} via {} metric {}", route.dst, route.gw, route.metric);
+// }
+// batch.Commit();
+//
+// all records carry the diagnostic context active at commit time.
+// like LineLogger, a batch must stay on the thread which created it.
+class LogBatch
+{
+public:
+    explicit LogBatch(Logger* logger) : logger_(logger), count_(0) {}
+
+    LogBatch(const LogBatch&) = delete;
+    LogBatch& operator=(const LogBatch&) = delete;
+
+    ~LogBatch()
+    {
+        Commit();
+    }
+
+    template <typename... Args>
+    void Add(LevelEnum level, const char* fmt, const Args&... args)
+    {
+        LogMessage* msg = _Next(level);
+        if (!msg)
+        {
+            return;
+        }
+        try
+        {
+            msg->raw.write(fmt, args...);
+        }
+        catch (const fmt::FormatError& e)
+        {
+            --count_;
+            throw SimpleException(
+                fmt::format("formatting error while processing format string '{}': {}",
+                fmt, e.what()));
+        }
+        _Captured(msg);
+    }
+
+    void Add(LevelEnum level, const char* what)
+    {
+        LogMessage* msg = _Next(level);
+        if (msg)
+        {
+            msg->raw << what;
+            _Captured(msg);
+        }
+    }
+
+    void Commit()
+    {
+        if (!count_)
+        {
+            return;
+        }
+        LogContext context = ContextStack::Local().View();
+        for (std::size_t i = 0; i < count_; ++i)
+        {
+            ptrs_[i]->context = context;
+        }
+        std::size_t count = count_;
+        count_ = 0;
+        logger_->_LogBatch(ptrs_.data(), count);
+    }
+
+    std::size_t size() const { return count_; }
+
+private:
+    // next free record, or nullptr if the level is filtered out.
+    // records live in a deque so they never move once created
+    LogMessage* _Next(LevelEnum level)
+    {
+        if (!logger_->ShouldLog(level))
+        {
+            return nullptr;
+        }
+        if (count_ == msgs_.size())
+        {
+            msgs_.emplace_back();
+            ptrs_.push_back(&msgs_.back());
+        }
+        LogMessage* msg = ptrs_[count_++];
+        msg->clear();
+        msg->level = level;
+        msg->time = os::now();
+        msg->thread_id = os::thread_id();
+        return msg;
+    }
+
+    // records below the sinks threshold only go to the backtrace, which
+    // the logger sorts out on commit
+    void _Captured(LogMessage* msg)
+    {
+        msg->logger_name = logger_->name();
+    }
+
+    Logger* logger_;
+    std::deque<LogMessage> msgs_;
+    std::vector<LogMessage*> ptrs_;
+    std::size_t count_;
+};
+} // ns pb
+
+#endif // PB_LOG_LOG_BATCH_H_
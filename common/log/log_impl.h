@@ -0,0 +1,190 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-18 10:02:37
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-18 11:45:19
+*/
+
+#ifndef PB_LOG_LOG_IMPL_H_
+#define PB_LOG_LOG_IMPL_H_
+
+#include "registry.h"
+#include "config.h"
+#include "config_watcher.h"
+#include "sinks/file_sink.h"
+#include "sinks/stdout_sink.h"
+#ifdef __linux__
+#include "sinks/syslog_sink.h"
+#endif
+
+inline std::shared_ptr<pb::Logger> pb::log::get(const LoggerKey& name)
+{
+    return Registry::instance().Get(name);
+}
+
+inline pb::LoggerHandle pb::log::handle(const LoggerKey& name)
+{
+    return Registry::instance().GetHandle(name);
+}
+
+inline void pb::log::drop(const std::string &name)
+{
+    Registry::instance().Drop(name);
+}
+
+// create multi/single threaded rotating file logger
+inline std::shared_ptr<pb::Logger> pb::log::rotating_logger_mt(
+    const std::string& logger_name, const std::string& filename,
+    size_t max_file_size, size_t max_files, bool force_flush)
+{
+    return create<RotatingFileSinkMt>(logger_name, filename, "txt",
+                                      max_file_size, max_files, force_flush);
+}
+
+inline std::shared_ptr<pb::Logger> pb::log::rotating_logger_st(
+    const std::string& logger_name, const std::string& filename,
+    size_t max_file_size, size_t max_files, bool force_flush)
+{
+    return create<RotatingFileSinkSt>(logger_name, filename, "txt",
+                                      max_file_size, max_files, force_flush);
+}
+
+// create file logger which creates new file at midnight
+inline std::shared_ptr<pb::Logger> pb::log::daily_logger_mt(
+    const std::string& logger_name, const std::string& filename,
+    int hour, int minute, bool force_flush)
+{
+    return create<DailyFileSinkMt>(logger_name, filename, "txt",
+                                   hour, minute, force_flush);
+}
+
+inline std::shared_ptr<pb::Logger> pb::log::daily_logger_st(
+    const std::string& logger_name, const std::string& filename,
+    int hour, int minute, bool force_flush)
+{
+    return create<DailyFileSinkSt>(logger_name, filename, "txt",
+                                   hour, minute, force_flush);
+}
+
+// create stdout/stderr loggers
+inline std::shared_ptr<pb::Logger> pb::log::stdout_logger_mt(
+    const std::string& logger_name)
+{
+    return create<StdoutSinkMt>(logger_name);
+}
+
+inline std::shared_ptr<pb::Logger> pb::log::stdout_logger_st(
+    const std::string& logger_name)
+{
+    return create<StdoutSinkSt>(logger_name);
+}
+
+inline std::shared_ptr<pb::Logger> pb::log::stderr_logger_mt(
+    const std::string& logger_name)
+{
+    return create<StderrSinkMt>(logger_name);
+}
+
+inline std::shared_ptr<pb::Logger> pb::log::stderr_logger_st(
+    const std::string& logger_name)
+{
+    return create<StderrSinkSt>(logger_name);
+}
+
+#ifdef __linux__
+// create syslog logger
+inline std::shared_ptr<pb::Logger> pb::log::syslog_logger(
+    const std::string& logger_name, const std::string& syslog_ident,
+    int syslog_option)
+{
+    return create<SyslogSink>(logger_name, syslog_ident, syslog_option);
+}
+#endif
+
+// create and register a logger with multiple sinks
+inline std::shared_ptr<pb::Logger> pb::log::create(
+    const std::string& logger_name, pb::sinks_init_list sinks)
+{
+    return Registry::instance().Create(logger_name, sinks.begin(), sinks.end());
+}
+
+template <typename Sink, typename... Args>
+inline std::shared_ptr<pb::Logger> pb::log::create(
+    const std::string& logger_name, const Args&... args)
+{
+    sink_ptr sink = std::make_shared<Sink>(args...);
+    return pb::log::create(logger_name, { sink });
+}
+
+template<class It>
+inline std::shared_ptr<pb::Logger> pb::log::create(
+    const std::string& logger_name, const It& sinks_begin, const It& sinks_end)
+{
+    return Registry::instance().Create(logger_name, sinks_begin, sinks_end);
+}
+
+inline void pb::log::set_formatter(pb::formatter_ptr f)
+{
+    Registry::instance().set_formatter(f);
+}
+
+inline void pb::log::set_pattern(const std::string& format_string)
+{
+    Registry::instance().set_pattern(format_string);
+}
+
+inline void pb::log::set_level(pb::LevelEnum log_level)
+{
+    Registry::instance().set_level(log_level);
+}
+
+inline void pb::log::set_level(const std::string& logger_name,
+                               pb::LevelEnum log_level)
+{
+    Registry::instance().set_level(logger_name, log_level);
+}
+
+inline void pb::log::reset_level(const std::string& logger_name)
+{
+    Registry::instance().ResetLevel(logger_name);
+}
+
+inline void pb::log::set_async_mode(
+    size_t queue_size, const AsyncOverflowPolicy overflow_policy,
+    const std::function<void()>& worker_warmup_cb)
+{
+    Registry::instance().set_async_mode(queue_size, overflow_policy,
+                                        worker_warmup_cb);
+}
+
+inline void pb::log::set_sync_mode()
+{
+    Registry::instance().set_sync_mode();
+}
+
+inline void pb::log::load_config(const std::string& path)
+{
+    Registry::instance().Apply(LogConfig::Load(path));
+}
+
+inline void pb::log::drop_all()
+{
+    Registry::instance().DropAll();
+}
+
+#endif // PB_LOG_LOG_IMPL_H_
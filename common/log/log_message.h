@@ -24,10 +24,24 @@
 #define PB_LOG_MESSAGE_H_
 
 #include <common/util/format.h>
+#ifdef PB_LOG_USE_ARENA
+#include <common/util/arena.h>
+#endif
 #include "common_def.h"
+#include "context.h"
 
 namespace pb
 {
+// the writer of a message's text. with PB_LOG_USE_ARENA defined, text which
+// outgrows the writer's inline buffer goes to the thread's Arena instead of
+// the heap (see util/arena.h); the MessagePool gives it back after each
+// message
+#ifdef PB_LOG_USE_ARENA
+typedef fmt::BasicMemoryWriter<char, ArenaAllocator<char> > LogWriter;
+#else
+typedef fmt::MemoryWriter LogWriter;
+#endif
+
 struct LogMessage
 {
     LogMessage() = default;
@@ -35,13 +49,21 @@ struct LogMessage
         logger_name(),
         level(l),
         time(),
+        thread_id(0),
+        context(),
+        level_start(0),
+        level_end(0),
         raw(),
         formatted() {}
 
     LogMessage(const LogMessage& other):
         logger_name(other.logger_name),
         level(other.level),
-        time(other.time)
+        time(other.time),
+        thread_id(other.thread_id),
+        context(other.context),
+        level_start(other.level_start),
+        level_end(other.level_end)
     {
         if (other.raw.size())
         {
@@ -59,6 +81,10 @@ struct LogMessage
         logger_name(std::move(other.logger_name)),
         level(other.level),
         time(std::move(other.time)),
+        thread_id(other.thread_id),
+        context(other.context),
+        level_start(other.level_start),
+        level_end(other.level_end),
         raw(std::move(other.raw)),
         formatted(std::move(other.formatted))
     {
@@ -74,6 +100,10 @@ struct LogMessage
         logger_name = std::move(other.logger_name);
         level = other.level;
         time = std::move(other.time);
+        thread_id = other.thread_id;
+        context = other.context;
+        level_start = other.level_start;
+        level_end = other.level_end;
         raw = std::move(other.raw);
         formatted = std::move(other.formatted);
         other.clear();
@@ -83,6 +113,8 @@ struct LogMessage
     void clear()
     {
         level = LevelEnum::kOff;
+        context = LogContext();
+        level_start = level_end = 0;
         raw.clear();
         formatted.clear();
     }
@@ -90,8 +122,14 @@ struct LogMessage
     std::string logger_name;
     LevelEnum level;
     log_clock::time_point time;
-    fmt::MemoryWriter raw; // raw string
-    fmt::MemoryWriter formatted; // formatted string
+    std::size_t thread_id; // of the thread which logged the message
+    LogContext context; // thread's diagnostic context, a view (see context.h)
+    // where the formatter put the level name in formatted, for sinks which
+    // highlight it. equal when there is none
+    std::size_t level_start;
+    std::size_t level_end;
+    LogWriter raw; // raw string
+    LogWriter formatted; // formatted string
 };
 } // ns pb
 #endif // PB_LOG_MESSAGE_H_
@@ -0,0 +1,91 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-24 09:18:52
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-24 11:05:27
+*/
+
+#ifndef PB_LOG_LOGFMT_FORMATTER_H_
+#define PB_LOG_LOGFMT_FORMATTER_H_
+
+// One logfmt record per line:
+//
+// ts=2015-03-24T09:18:52.123+08:00 level=info logger=db thread=1234
+// msg="connected to primary" req=42 tenant=acme
+//
+// Values are quoted only when they contain a space, '=', '"', '\' or a
+// control character (util/escape.h). The diagnostic context (see
+// context.h) is written as fields after msg, in push order.
+//
+// Example:
+//
+// logger->set_formatter(std::make_shared<pb::logfmt_formatter>());
+
+#include <common/util/escape.h>
+#include <common/util/format.h>
+#include <common/util/os_spec.h>
+#include "common_def.h"
+#include "formatter.h"
+#include "log_message.h"
+#include "pattern_formatter.h"
+
+namespace pb
+{
+class logfmt_formatter : public formatter
+{
+public:
+    logfmt_formatter();
+    logfmt_formatter(const logfmt_formatter&) = delete;
+    logfmt_formatter& operator=(const logfmt_formatter&) = delete;
+
+    void format(LogMessage& msg) override;
+
+private:
+    // the text up to the logger name. level names need no quotes, so they
+    // are part of it
+    pattern_formatter prefix_;
+};
+} // ns pb
+
+inline pb::logfmt_formatter::logfmt_formatter() :
+    prefix_("ts=%Y-%m-%dT%H:%M:%S.%e%z level=%l logger=", false)
+{
+}
+
+inline void pb::logfmt_formatter::format(LogMessage& msg)
+{
+    LogWriter& w = msg.formatted;
+    prefix_.format(msg);
+    LogfmtValue(w, msg.logger_name.data(), msg.logger_name.size());
+    details::Append(w, " thread=", 8);
+    w << msg.thread_id;
+    details::Append(w, " msg=", 5);
+    LogfmtValue(w, msg.raw.data(), msg.raw.size());
+    const LogContext& ctx = msg.context;
+    for (std::size_t i = 0; i < ctx.field_count; ++i)
+    {
+        const ContextField& field = ctx.fields[i];
+        w << ' ';
+        LogfmtKey(w, ctx.data + field.key_offset, field.key_size);
+        w << '=';
+        LogfmtValue(w, ctx.data + field.value_offset, field.value_size);
+    }
+    details::Append(w, os::eol(), os::eol_size());
+}
+
+#endif // PB_LOG_LOGFMT_FORMATTER_H_
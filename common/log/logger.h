@@ -25,13 +25,20 @@
 
 #include <vector>
 #include <memory>
+#include <mutex>
 #include "sinks/base_sink.h"
 #include "common_def.h"
+#include "backtrace.h"
+#include "formatter.h"
+#include "logger_settings.h"
+#include "pattern_formatter.h"
 
 namespace pb
 {
 // forward declaration
 class LineLogger;
+class LogBatch;
+class Registry;
 
 class Logger
 {
@@ -46,12 +53,22 @@ public:
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
+    // a registered logger's level is also set by pb::log::set_level on its
+    // name or an ancestor's, whichever came last
     void set_level(LevelEnum);
     LevelEnum level() const;
+    // recompute the effective threshold after a sink's level was lowered
+    void RefreshLevel();
 
     const std::string& name() const;
     bool ShouldLog(LevelEnum) const;
 
+    // cap the message text (before the formatter adds its prefix) at n
+    // characters. the rest is dropped while formatting, so long arguments
+    // cost no allocation beyond n. 0, the default, means no cap
+    void set_max_message_size(std::size_t n);
+    std::size_t max_message_size() const;
+
     // logger.info(cppformat_string, arg1, arg2, arg3, ...) call style
     template <typename... Args>
     LineLogger trace(const char* format, const Args&... args);
@@ -92,11 +109,38 @@ public:
     LineLogger ForceLog(LevelEnum level, const char* format,
                         const Args&... args);
 
-    // set the format of the log messages from this logger
+    // keep the last n messages from capture_level up to the logger threshold
+    // in memory, and write them to the sinks before the next error (or on
+    // DumpBacktrace). sinks still apply their own level to dumped messages.
+    // the text of a kept message is cut at Backtracer::kMaxText characters.
+    // enabling again replaces the ring and its messages
+    void EnableBacktrace(std::size_t n, LevelEnum capture_level = kTrace);
+    void DisableBacktrace();
+    void DumpBacktrace();
+
+    // set the format of the log messages from this logger.
+    // sinks with a formatter of their own (Sink::set_formatter) keep it
     void set_pattern(const std::string&);
     void set_formatter(formatter_ptr);
 protected:
-    virtual void _LogMsg(LogMessage&);
+    // a finished message goes to the sinks if the settings in effect take
+    // it (or it is forced), to the backtrace otherwise. the level check and
+    // the sinks and formatter used come from the same settings version
+    void _SubmitMsg(LogMessage&, bool forced);
+    virtual void _LogMsg(LogMessage&, const LoggerSettings&);
+    // hand a message over to the sinks. the async logger queues it instead
+    virtual void _SinkMsg(LogMessage&, const LoggerSettings&);
+    // records collected by a LogBatch. those the settings don't take go to
+    // the backtrace, the rest to _SinkBatch. reorders msgs
+    void _LogBatch(LogMessage** msgs, std::size_t count);
+    // write records with one pass over the sinks
+    virtual void _SinkBatch(LogMessage* const* msgs, std::size_t count,
+                            const LoggerSettings&);
+    void _DumpBacktrace(const LoggerSettings&);
+    virtual void _BacktraceMsg(LogMessage&);
+    // messages from here up reach the sinks: the settings' level or the
+    // lowest sink level, whichever is higher
+    static int _Threshold(const LoggerSettings&);
     virtual void _SetPattern(const std::string&);
     virtual void _SetFormatter(formatter_ptr);
     LineLogger _LogIfEnabled(LevelEnum level);
@@ -107,11 +151,43 @@ protected:
     template<typename T>
     inline LineLogger _LogIfEnabled(LevelEnum level, const T& msg);
 
+    void _UpdateLevel();
+    // called by the registry when the logger is dropped. waits for the log
+    // calls in progress, then releases the async worker, the sinks and the
+    // backtrace. the object itself stays, and logging
+    // to it afterwards does nothing
+    void _Close();
+    // releases what a derived logger owns, after the log calls are over
+    virtual void _Shutdown();
+
     friend LineLogger;
+    friend LogBatch;
+    friend Registry;
     std::string name_;
-    std::vector<sink_ptr> sinks_;
-    formatter_ptr formatter_;
+    SettingsSlot settings_;
+    // ShouldLog threshold, a quick filter ahead of the settings: the lowest
+    // _Threshold of the settings a log call may take, lowered to
+    // backtrace_level_ while the backtrace is enabled
     std::atomic_int level_;
+    std::atomic<std::size_t> max_message_size_;
+    std::atomic_bool closed_;
+
+    // a replaced ring and the Epoch stamp it was retired with
+    struct RetiredBacktracer
+    {
+        std::uint64_t stamp;
+        std::unique_ptr<Backtracer> tracer;
+    };
+
+    std::atomic_int backtrace_level_;
+    // log calls use the ring inside an Epoch::Guard. a replaced one is
+    // released by a later EnableBacktrace, or with the logger, once no
+    // guard can still be using it
+    std::atomic<Backtracer*> backtracer_;
+    std::mutex backtrace_mutex_;
+    std::unique_ptr<Backtracer> backtrace_ring_;
+    // replaced rings which may still be in use, oldest first
+    std::vector<RetiredBacktracer> retired_backtracers_;
 };
 }
 #endif // PB_LOG_LOGGER_H_
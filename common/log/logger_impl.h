@@ -20,18 +20,26 @@
 * @Last Modified time: 2015-03-11 14:17:26
 */
 
+#include <algorithm>
+#include <iterator>
 #include "line_logger.h"
+#include "dispatch.h"
 
 // create logger with given name, sinks and the default pattern formatter
 // all other ctors will call this one
 template<class It>
 inline pb::Logger::Logger(const std::string& logger_name,
                           const It& begin, const It& end) :
-    name_(logger_name), sinks_(begin, end),
-    _formatter(std::make_shared<pattern_formatter>("%+"))
+    name_(logger_name),
+    settings_(LoggerSettings(kInfo, std::make_shared<pattern_formatter>("%+"),
+                             std::vector<sink_ptr>(begin, end)))
 {
     // no support under vs2013 for member initialization for std::atomic
-    level_ = kInfo;
+    max_message_size_ = 0;
+    closed_ = false;
+    backtrace_level_ = kOff;
+    backtracer_ = nullptr;
+    _UpdateLevel();
 }
 
 // ctor with sinks as init list
@@ -207,7 +215,7 @@ template <typename... Args>
 inline pb::LineLogger pb::Logger::ForceLog(
     LevelEnum level, const char *fmt, const Args&... args)
 {
-    pb::LineLogger logger(this, level, true);
+    pb::LineLogger logger(this, level, true, true);
     logger.write(fmt, args...);
     return logger;
 }
@@ -217,12 +225,59 @@ inline const std::string& pb::Logger::name() const { return name_; }
 
 inline void pb::Logger::set_level(pb::LevelEnum log_level)
 {
-    level_.store(log_level);
+    settings_.Update([log_level](LoggerSettings& settings)
+    {
+        settings.level = log_level;
+    });
+    _UpdateLevel();
 }
 
 inline pb::LevelEnum pb::Logger::level() const
 {
-    return static_cast<pb::LevelEnum>(level_.load(std::memory_order_relaxed));
+    Epoch::Guard guard;
+    return settings_.get().level;
+}
+
+inline void pb::Logger::set_max_message_size(std::size_t n)
+{
+    max_message_size_.store(n, std::memory_order_relaxed);
+}
+
+inline std::size_t pb::Logger::max_message_size() const
+{
+    return max_message_size_.load(std::memory_order_relaxed);
+}
+
+inline void pb::Logger::RefreshLevel()
+{
+    _UpdateLevel();
+}
+
+// messages no sink accepts are rejected by ShouldLog before any work is
+// done, unless the backtrace wants them. while settings are staged both
+// the current and the staged ones are let through
+inline void pb::Logger::_UpdateLevel()
+{
+    int threshold = kOff;
+    settings_.ForEachVisible([&threshold](const LoggerSettings& settings)
+    {
+        threshold = std::min(threshold, _Threshold(settings));
+    });
+    level_.store(std::min<int>(threshold, backtrace_level_.load()));
+    if (closed_.load())
+    {
+        level_.store(kOff);
+    }
+}
+
+inline int pb::Logger::_Threshold(const LoggerSettings& settings)
+{
+    int sinks_level = kOff;
+    for (auto &sink : settings.sinks)
+    {
+        sinks_level = std::min<int>(sinks_level, sink->level());
+    }
+    return std::max<int>(settings.level, sinks_level);
 }
 
 inline bool pb::Logger::ShouldLog(pb::LevelEnum msg_level) const
@@ -230,23 +285,195 @@ inline bool pb::Logger::ShouldLog(pb::LevelEnum msg_level) const
     return msg_level >= level_.load(std::memory_order_relaxed);
 }
 
-// protected virtual called at end of each user log call (if enabled)
-// by the line_logger
-inline void pb::Logger::_LogMsg(LogMessage& msg)
+inline void pb::Logger::EnableBacktrace(std::size_t n, LevelEnum capture_level)
+{
+    {
+        // released after the unlock, like SettingsSlot does
+        std::vector<RetiredBacktracer> released;
+        std::lock_guard<std::mutex> lock(backtrace_mutex_);
+        if (closed_.load())
+        {
+            return;
+        }
+        std::unique_ptr<Backtracer> tracer(new Backtracer(n));
+        backtracer_.store(tracer.get(), std::memory_order_release);
+        if (backtrace_ring_)
+        {
+            RetiredBacktracer retired = {Epoch::Global().Retire(),
+                                         std::move(backtrace_ring_)};
+            retired_backtracers_.push_back(std::move(retired));
+        }
+        backtrace_ring_ = std::move(tracer);
+        // stamps grow along retired_backtracers_
+        auto end = retired_backtracers_.begin();
+        while (end != retired_backtracers_.end() &&
+               Epoch::Global().Quiescent(end->stamp))
+        {
+            ++end;
+        }
+        std::move(retired_backtracers_.begin(), end,
+                  std::back_inserter(released));
+        retired_backtracers_.erase(retired_backtracers_.begin(), end);
+    }
+    backtrace_level_.store(capture_level);
+    _UpdateLevel();
+}
+
+inline void pb::Logger::DisableBacktrace()
+{
+    backtrace_level_.store(kOff);
+    _UpdateLevel();
+}
+
+inline void pb::Logger::DumpBacktrace()
+{
+    Epoch::Guard guard;
+    if (closed_.load())
+    {
+        return;
+    }
+    _DumpBacktrace(settings_.get());
+}
+
+// called inside an Epoch::Guard
+inline void pb::Logger::_DumpBacktrace(const LoggerSettings& settings)
 {
-    formatter_->format(msg);
-    for (auto &sink : sinks_)
+    Backtracer* tracer = backtracer_.load(std::memory_order_acquire);
+    if (!tracer)
+    {
+        return;
+    }
+    LogMessage* msg = MessagePool::Acquire(kOff);
+    msg->logger_name = name_;
+    try
+    {
+        tracer->Drain(*msg, [this, &settings](LogMessage& m)
+        {
+            _SinkMsg(m, settings);
+        });
+    }
+    catch (...)
     {
-        sink->Log(msg);
+        MessagePool::Release(msg);
+        throw;
     }
+    MessagePool::Release(msg);
+}
+
+// called at end of each user log call (if enabled) by the line_logger
+inline void pb::Logger::_SubmitMsg(LogMessage& msg, bool forced)
+{
+    Epoch::Guard guard;
+    if (closed_.load())
+    {
+        return;
+    }
+    const LoggerSettings& settings = settings_.get();
+    if (forced || msg.level >= _Threshold(settings))
+    {
+        _LogMsg(msg, settings);
+    }
+    else
+    {
+        _BacktraceMsg(msg);
+    }
+}
+
+// protected virtual called inside an Epoch::Guard, with the settings in
+// effect. formats once per distinct sink formatter.
+// an error first flushes the backtrace, so its context precedes it.
+inline void pb::Logger::_LogMsg(LogMessage& msg, const LoggerSettings& settings)
+{
+    if (msg.level >= kError)
+    {
+        _DumpBacktrace(settings);
+    }
+    _SinkMsg(msg, settings);
+}
+
+inline void pb::Logger::_SinkMsg(LogMessage& msg,
+                                 const LoggerSettings& settings)
+{
+    DispatchMsg(msg, settings.sinks, settings.formatter.get());
+}
+
+inline void pb::Logger::_LogBatch(LogMessage** msgs, std::size_t count)
+{
+    Epoch::Guard guard;
+    if (closed_.load())
+    {
+        return;
+    }
+    const LoggerSettings& settings = settings_.get();
+    int threshold = _Threshold(settings);
+    bool error = false;
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (msgs[i]->level < threshold)
+        {
+            _BacktraceMsg(*msgs[i]);
+            continue;
+        }
+        error = error || msgs[i]->level >= kError;
+        std::swap(msgs[n++], msgs[i]);
+    }
+    if (error)
+    {
+        _DumpBacktrace(settings);
+    }
+    _SinkBatch(msgs, n, settings);
+}
+
+inline void pb::Logger::_SinkBatch(LogMessage* const* msgs, std::size_t count,
+                                   const LoggerSettings& settings)
+{
+    DispatchBatch(msgs, count, settings.sinks, settings.formatter.get());
+}
+
+// called instead of _LogMsg for messages below the sinks threshold.
+// keeps the raw text only, no formatting is done
+inline void pb::Logger::_BacktraceMsg(LogMessage& msg)
+{
+    Epoch::Guard guard;
+    Backtracer* tracer = backtracer_.load(std::memory_order_acquire);
+    if (tracer && msg.level >= backtrace_level_.load(std::memory_order_relaxed))
+    {
+        tracer->Push(msg);
+    }
+}
+
+// log calls check closed_ inside their guard, so once the guards entered
+// before it was set are over nothing uses the sinks, the backtrace or the
+// async worker any more
+inline void pb::Logger::_Close()
+{
+    closed_.store(true);
+    level_.store(kOff);
+    Epoch::Global().Synchronize();
+    _Shutdown();
+    settings_.Reset(LoggerSettings(kOff, nullptr, std::vector<sink_ptr>()));
+    std::unique_ptr<Backtracer> ring;
+    std::vector<RetiredBacktracer> retired;
+    std::lock_guard<std::mutex> lock(backtrace_mutex_);
+    backtracer_.store(nullptr, std::memory_order_release);
+    ring.swap(backtrace_ring_);
+    retired.swap(retired_backtracers_);
+}
+
+inline void pb::Logger::_Shutdown()
+{
 }
 
 inline void pb::Logger::_SetPattern(const std::string& pattern)
 {
-    formatter_ = std::make_shared<pattern_formatter>(pattern);
+    _SetFormatter(std::make_shared<pattern_formatter>(pattern));
 }
 
 inline void pb::Logger::_SetFormatter(formatter_ptr msg_formatter)
 {
-    formatter_ = msg_formatter;
+    settings_.Update([&msg_formatter](LoggerSettings& settings)
+    {
+        settings.formatter = msg_formatter;
+    });
 }
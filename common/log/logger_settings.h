@@ -0,0 +1,250 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-31 09:40:12
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-31 16:25:37
+*/
+
+#ifndef PB_LOG_LOGGER_SETTINGS_H_
+#define PB_LOG_LOGGER_SETTINGS_H_
+
+// What a logger applies to a message (level, formatter, sinks), published as
+// one immutable version, so that a log call takes all of it from the same
+// configuration. Log calls read the version in effect inside an Epoch::Guard
+// (util/epoch.h) with a few loads and never block; a replaced version is
+// released once no guard can still be using it.
+// A version can also be staged on many loggers and put in effect on all of
+// them at once by a single store (SettingsSlot::Commit). The registry
+// applies a configuration that way.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <common/util/epoch.h>
+#include "common_def.h"
+#include "formatter.h"
+
+namespace pb
+{
+struct LoggerSettings
+{
+    LoggerSettings() : level(kInfo) {}
+    LoggerSettings(LevelEnum l, formatter_ptr f, std::vector<sink_ptr> s) :
+        level(l), formatter(std::move(f)), sinks(std::move(s)) {}
+
+    // level set on the logger. the sinks' levels apply on top
+    LevelEnum level;
+    // for the sinks without a formatter of their own
+    formatter_ptr formatter;
+    std::vector<sink_ptr> sinks;
+};
+
+class SettingsSlot
+{
+public:
+    explicit SettingsSlot(const LoggerSettings& settings)
+    {
+        // no support under vs2013 for member initialization for std::atomic
+        prev_ = next_ = nullptr;
+        set(settings);
+    }
+
+    SettingsSlot(const SettingsSlot&) = delete;
+    SettingsSlot& operator=(const SettingsSlot&) = delete;
+
+    // the version in effect. call inside an Epoch::Guard and use it until
+    // the guard ends
+    const LoggerSettings& get() const
+    {
+        const Version* v = next_.load(std::memory_order_acquire);
+        if (v->generation > Committed().load(std::memory_order_acquire))
+        {
+            v = prev_.load(std::memory_order_acquire);
+        }
+        return v->settings;
+    }
+
+    // copy of the version in effect, to base a change on
+    LoggerSettings current() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return _Current()->settings;
+    }
+
+    // calls f with each version a log call may take: the one in effect and
+    // the staged one, if any
+    template <class Func>
+    void ForEachVisible(const Func& f) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        f(next_owner_->settings);
+        if (_Current() != next_owner_)
+        {
+            f(prev_owner_->settings);
+        }
+    }
+
+    // puts settings in effect right away. drops a staged version
+    void set(const LoggerSettings& settings)
+    {
+        std::vector<Retired> released;
+        std::lock_guard<std::mutex> lock(mutex_);
+        _Publish(settings, 0, released);
+    }
+
+    // the version in effect changed by f, in effect right away. f runs
+    // under the slot mutex, so concurrent updates don't get lost
+    template <class Func>
+    void Update(const Func& f)
+    {
+        std::vector<Retired> released;
+        std::lock_guard<std::mutex> lock(mutex_);
+        LoggerSettings settings = _Current()->settings;
+        f(settings);
+        _Publish(settings, 0, released);
+    }
+
+    // puts settings in effect and releases every other version right away,
+    // staged and retired ones included. only for a slot no log call can
+    // still be reading (a closed logger's)
+    void Reset(const LoggerSettings& settings)
+    {
+        // released after the unlock
+        std::vector<Retired> released;
+        std::shared_ptr<const Version> prev;
+        std::shared_ptr<const Version> next;
+        std::lock_guard<std::mutex> lock(mutex_);
+        prev.swap(prev_owner_);
+        next.swap(next_owner_);
+        _Publish(settings, 0, released);
+        released.insert(released.end(), retired_.begin(), retired_.end());
+        retired_.clear();
+    }
+
+    // stages settings, in effect once generation is committed. the caller
+    // commits right after staging, whatever it staged
+    void Stage(const LoggerSettings& settings, std::uint64_t generation)
+    {
+        std::vector<Retired> released;
+        std::lock_guard<std::mutex> lock(mutex_);
+        _Publish(settings, generation, released);
+    }
+
+    // a generation to stage with, above every generation handed out so far
+    static std::uint64_t NextGeneration()
+    {
+        static std::atomic<std::uint64_t> s_generations(0);
+        return s_generations.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // puts every version staged with generation (or before) in effect
+    static void Commit(std::uint64_t generation)
+    {
+        std::atomic<std::uint64_t>& committed = Committed();
+        std::uint64_t c = committed.load(std::memory_order_relaxed);
+        while (c < generation &&
+               !committed.compare_exchange_weak(c, generation,
+                                                std::memory_order_release))
+        {
+        }
+    }
+
+private:
+    struct Version
+    {
+        Version(const LoggerSettings& s, std::uint64_t g) :
+            settings(s), generation(g) {}
+
+        LoggerSettings settings;
+        // 0 for a version in effect as soon as it is published
+        std::uint64_t generation;
+    };
+
+    // a replaced version and the Epoch stamp it was retired with
+    struct Retired
+    {
+        std::uint64_t stamp;
+        std::shared_ptr<const Version> version;
+    };
+
+    static std::atomic<std::uint64_t>& Committed()
+    {
+        static std::atomic<std::uint64_t> s_committed(0);
+        return s_committed;
+    }
+
+    // called with mutex_ held
+    const std::shared_ptr<const Version>& _Current() const
+    {
+        return next_owner_->generation <= Committed().load() ? next_owner_
+                                                             : prev_owner_;
+    }
+
+    // called with mutex_ held. what is released goes to released, for the
+    // caller to destroy after the unlock: a sink's destructor may log
+    void _Publish(const LoggerSettings& settings, std::uint64_t generation,
+                  std::vector<Retired>& released)
+    {
+        std::shared_ptr<const Version> next =
+            std::make_shared<Version>(settings, generation);
+        std::shared_ptr<const Version> prev =
+            generation && next_owner_ ? _Current() : next;
+        // a log call loads next_ before prev_
+        prev_.store(prev.get(), std::memory_order_release);
+        next_.store(next.get(), std::memory_order_release);
+        _Retire(prev_owner_, prev);
+        if (next_owner_ != prev_owner_)
+        {
+            _Retire(next_owner_, prev);
+        }
+        prev_owner_ = prev;
+        next_owner_ = next;
+        // stamps grow along retired_
+        auto end = retired_.begin();
+        while (end != retired_.end() && Epoch::Global().Quiescent(end->stamp))
+        {
+            ++end;
+        }
+        released.assign(retired_.begin(), end);
+        retired_.erase(retired_.begin(), end);
+    }
+
+    // called with mutex_ held
+    void _Retire(const std::shared_ptr<const Version>& old,
+                 const std::shared_ptr<const Version>& kept)
+    {
+        if (old && old != kept)
+        {
+            Retired retired = {Epoch::Global().Retire(), old};
+            retired_.push_back(retired);
+        }
+    }
+
+    std::atomic<const Version*> prev_;
+    std::atomic<const Version*> next_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<const Version> prev_owner_;
+    std::shared_ptr<const Version> next_owner_;
+    // replaced versions which may still be in use, oldest first
+    std::vector<Retired> retired_;
+};
+} // ns pb
+
+#endif // PB_LOG_LOGGER_SETTINGS_H_
@@ -0,0 +1,110 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-12 17:20:41
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-12 18:35:16
+*/
+
+#ifndef PB_LOG_MESSAGE_POOL_H_
+#define PB_LOG_MESSAGE_POOL_H_
+
+#include <cstddef>
+#include "common_def.h"
+#include "log_message.h"
+
+namespace pb
+{
+// per thread scratch messages borrowed by LineLogger.
+// the raw/formatted writers keep their capacity between log calls, so once a
+// thread has seen a long message the next ones don't hit malloc.
+// a LineLogger created while another one is being filled (logging from inside
+// a user operator<<, or from a sink) takes the next free slot. nesting deeper
+// than kSlots falls back to a heap allocated message.
+// a borrowed message must be released by the thread which acquired it.
+class MessagePool
+{
+public:
+    static const unsigned kSlots = 4;
+    // writers grown beyond this are shrunk back on release, so a single huge
+    // message doesn't pin memory for the rest of the thread's life.
+    // arena backed writers keep nothing beyond their inline buffer, so the
+    // thread's arena starts over once no message is being filled
+#ifdef PB_LOG_USE_ARENA
+    static const std::size_t kMaxRetainedCapacity =
+        fmt::internal::INLINE_BUFFER_SIZE;
+#else
+    static const std::size_t kMaxRetainedCapacity = 64 * 1024;
+#endif
+
+    static LogMessage* Acquire(LevelEnum level)
+    {
+        Slots& slots = _LocalSlots();
+        for (unsigned i = 0; i < kSlots; ++i)
+        {
+            unsigned bit = 1u << i;
+            if (!(slots.in_use & bit))
+            {
+                slots.in_use |= bit;
+                slots.msgs[i].level = level;
+                return &slots.msgs[i];
+            }
+        }
+        return new LogMessage(level);
+    }
+
+    static void Release(LogMessage* msg)
+    {
+        Slots& slots = _LocalSlots();
+        for (unsigned i = 0; i < kSlots; ++i)
+        {
+            if (msg == &slots.msgs[i])
+            {
+                _Trim(msg->raw);
+                _Trim(msg->formatted);
+                msg->clear();
+                slots.in_use &= ~(1u << i);
+                return;
+            }
+        }
+        delete msg;
+    }
+
+private:
+    struct Slots
+    {
+        Slots() : in_use(0) {}
+        LogMessage msgs[kSlots];
+        unsigned in_use;
+    };
+
+    static Slots& _LocalSlots()
+    {
+        static thread_local Slots t_slots;
+        return t_slots;
+    }
+
+    static void _Trim(LogWriter& w)
+    {
+        if (w.capacity() > kMaxRetainedCapacity)
+        {
+            w = LogWriter();
+        }
+    }
+};
+} // ns pb
+#endif // PB_LOG_MESSAGE_POOL_H_
@@ -0,0 +1,716 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-20 10:12:45
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-20 17:58:02
+*/
+
+#ifndef PB_LOG_PATTERN_FORMATTER_H_
+#define PB_LOG_PATTERN_FORMATTER_H_
+
+// Pattern flags:
+//
+// %v message             %n logger name        %l level (info)
+// %L short level (I)     %t thread id          %P process id
+// %X diagnostic context (key=value ..., see context.h)
+// %Y year (2015)         %C short year (15)    %m month (01-12)
+// %d day (01-31)         %H hour (00-23)       %I hour (01-12)
+// %M minute              %S second             %e millis (000-999)
+// %f micros              %F nanos              %p AM/PM
+// %a weekday (Thu)       %A weekday (Thursday) %b / %h month (Aug)
+// %B month (August)      %D / %x date (08/23/15)
+// %T ISO time (15:35:46) %R time (15:35)
+// %r 12 hour time (03:35:46 PM)               %c date and time
+// %z utc offset (+08:00) %% percent sign
+// %+ default: [2015-03-20 10:12:45.123] [name] [info] [context] message
+//    ([context] only when there is one)
+//
+// The pattern is compiled once into a sequence of flag formatters, so
+// formatting a message is a loop of virtual calls, with no parsing and no
+// switch on the flag characters. Consecutive date/time flags are rendered
+// once per second and thread (see TimeRunFlag), so most messages don't
+// convert the time at all.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+#include <common/util/format.h>
+#include <common/util/os_spec.h>
+#include <common/util/timezone.h>
+#include "common_def.h"
+#include "formatter.h"
+#include "log_message.h"
+
+namespace pb
+{
+namespace details
+{
+class FlagFormatter
+{
+public:
+    virtual ~FlagFormatter() {}
+    virtual void format(LogMessage& msg, const std::tm& tm_time) = 0;
+};
+
+inline void Append(fmt::Writer& w, const char* s, std::size_t size)
+{
+    w << fmt::StringRef(s, size);
+}
+
+// n zero padded to width digits. n must fit
+inline void AppendPadded(fmt::Writer& w, unsigned n, unsigned width)
+{
+    char buf[10];
+    for (unsigned i = width; i > 0; --i)
+    {
+        buf[i - 1] = static_cast<char>('0' + n % 10);
+        n /= 10;
+    }
+    Append(w, buf, width);
+}
+
+inline void Append2(fmt::Writer& w, int n)
+{
+    char buf[2] = {static_cast<char>('0' + n / 10), static_cast<char>('0' + n % 10)};
+    Append(w, buf, 2);
+}
+
+// fraction of the second of t, in units of Duration
+template <typename Duration>
+inline unsigned SubSecond(log_clock::time_point t)
+{
+    auto duration = t.time_since_epoch();
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(duration);
+    return static_cast<unsigned>(
+        std::chrono::duration_cast<Duration>(duration - secs).count());
+}
+
+inline int To12h(const std::tm& t)
+{
+    return t.tm_hour > 12 ? t.tm_hour - 12 : (t.tm_hour ? t.tm_hour : 12);
+}
+
+static const char* const kDays[] {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char* const kFullDays[] {"Sunday", "Monday", "Tuesday", "Wednesday",
+                                      "Thursday", "Friday", "Saturday"};
+static const char* const kMonths[] {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+static const char* const kFullMonths[] {"January", "February", "March", "April",
+                                        "May", "June", "July", "August",
+                                        "September", "October", "November",
+                                        "December"};
+
+// %a
+class AbbrWeekdayFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append(msg.formatted, kDays[tm_time.tm_wday], 3);
+    }
+};
+
+// %A
+class WeekdayFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        msg.formatted << kFullDays[tm_time.tm_wday];
+    }
+};
+
+// %b, %h
+class AbbrMonthFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append(msg.formatted, kMonths[tm_time.tm_mon], 3);
+    }
+};
+
+// %B
+class MonthFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        msg.formatted << kFullMonths[tm_time.tm_mon];
+    }
+};
+
+// %c: Thu Aug 23 15:35:46 2015
+class DateTimeFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        LogWriter& w = msg.formatted;
+        Append(w, kDays[tm_time.tm_wday], 3);
+        w << ' ';
+        Append(w, kMonths[tm_time.tm_mon], 3);
+        w << ' ';
+        Append2(w, tm_time.tm_mday);
+        w << ' ';
+        Append2(w, tm_time.tm_hour);
+        w << ':';
+        Append2(w, tm_time.tm_min);
+        w << ':';
+        Append2(w, tm_time.tm_sec);
+        w << ' ';
+        AppendPadded(w, tm_time.tm_year + 1900, 4);
+    }
+};
+
+// %C
+class ShortYearFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append2(msg.formatted, tm_time.tm_year % 100);
+    }
+};
+
+// %Y
+class YearFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        AppendPadded(msg.formatted, tm_time.tm_year + 1900, 4);
+    }
+};
+
+// %D, %x: 08/23/15
+class ShortDateFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        LogWriter& w = msg.formatted;
+        Append2(w, tm_time.tm_mon + 1);
+        w << '/';
+        Append2(w, tm_time.tm_mday);
+        w << '/';
+        Append2(w, tm_time.tm_year % 100);
+    }
+};
+
+// %m
+class MonthNumFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append2(msg.formatted, tm_time.tm_mon + 1);
+    }
+};
+
+// %d
+class DayFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append2(msg.formatted, tm_time.tm_mday);
+    }
+};
+
+// %H
+class HourFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append2(msg.formatted, tm_time.tm_hour);
+    }
+};
+
+// %I
+class Hour12Flag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append2(msg.formatted, To12h(tm_time));
+    }
+};
+
+// %M
+class MinuteFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append2(msg.formatted, tm_time.tm_min);
+    }
+};
+
+// %S
+class SecondFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append2(msg.formatted, tm_time.tm_sec);
+    }
+};
+
+// %e, %f, %F
+template <typename Duration, unsigned Digits>
+class SubSecondFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        AppendPadded(msg.formatted, SubSecond<Duration>(msg.time), Digits);
+    }
+};
+
+// %p
+class AmPmFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append(msg.formatted, tm_time.tm_hour >= 12 ? "PM" : "AM", 2);
+    }
+};
+
+// %r: 03:35:46 PM
+class Time12Flag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        LogWriter& w = msg.formatted;
+        Append2(w, To12h(tm_time));
+        w << ':';
+        Append2(w, tm_time.tm_min);
+        w << ':';
+        Append2(w, tm_time.tm_sec);
+        Append(w, tm_time.tm_hour >= 12 ? " PM" : " AM", 3);
+    }
+};
+
+// %R: 15:35
+class HourMinuteFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        Append2(msg.formatted, tm_time.tm_hour);
+        msg.formatted << ':';
+        Append2(msg.formatted, tm_time.tm_min);
+    }
+};
+
+// %T: 15:35:46
+class IsoTimeFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        LogWriter& w = msg.formatted;
+        Append2(w, tm_time.tm_hour);
+        w << ':';
+        Append2(w, tm_time.tm_min);
+        w << ':';
+        Append2(w, tm_time.tm_sec);
+    }
+};
+
+// %z: +08:00
+class UtcOffsetFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm& tm_time) override
+    {
+        int offset = os::utc_minutes_offset(tm_time);
+        char sign = '+';
+        if (offset < 0)
+        {
+            sign = '-';
+            offset = -offset;
+        }
+        msg.formatted << sign;
+        Append2(msg.formatted, offset / 60);
+        msg.formatted << ':';
+        Append2(msg.formatted, offset % 60);
+    }
+};
+
+// %l
+class LevelFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        msg.level_start = msg.formatted.size();
+        msg.formatted << to_str(msg.level);
+        msg.level_end = msg.formatted.size();
+    }
+};
+
+// %L
+class ShortLevelFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        msg.level_start = msg.formatted.size();
+        msg.formatted << to_short_str(msg.level);
+        msg.level_end = msg.formatted.size();
+    }
+};
+
+// %n
+class NameFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        Append(msg.formatted, msg.logger_name.data(), msg.logger_name.size());
+    }
+};
+
+// %t
+class ThreadIdFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        msg.formatted << msg.thread_id;
+    }
+};
+
+// %P. the pid is taken once, when the pattern is compiled
+class PidFlag : public FlagFormatter
+{
+public:
+    PidFlag()
+    {
+        fmt::MemoryWriter w;
+        w << os::pid();
+        pid_ = w.str();
+    }
+
+private:
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        Append(msg.formatted, pid_.data(), pid_.size());
+    }
+
+    std::string pid_;
+};
+
+// %v
+class MessageFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        Append(msg.formatted, msg.raw.data(), msg.raw.size());
+    }
+};
+
+// %X
+class ContextFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        Append(msg.formatted, msg.context.data, msg.context.size);
+    }
+};
+
+// literal text between flags, including %%
+class LiteralFlag : public FlagFormatter
+{
+public:
+    void Add(char c)
+    {
+        txt_ += c;
+    }
+
+private:
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        Append(msg.formatted, txt_.data(), txt_.size());
+    }
+
+    std::string txt_;
+};
+
+// "[context] " for %+, when there is a context
+class OptionalContextFlag : public FlagFormatter
+{
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        if (!msg.context.empty())
+        {
+            msg.formatted << '[';
+            Append(msg.formatted, msg.context.data, msg.context.size);
+            Append(msg.formatted, "] ", 2);
+        }
+    }
+};
+
+// how a flag depends on the message
+enum FlagKind
+{
+    kLiteralKind, // constant text
+    kTimeKind, // the time, at second resolution
+    kOtherKind
+};
+
+// a run of second resolution time flags and literals, e.g.
+// "[%Y-%m-%d %H:%M:%S." in "[%Y-%m-%d %H:%M:%S.%e]".
+// the rendered text is cached per thread, so messages logged in the same
+// second as the previous one cost a single append: no time conversion and
+// no digit formatting. misses convert with the timezone cache (no lock).
+// sub second flags (%e %f %F) are outside the run.
+class TimeRunFlag : public FlagFormatter
+{
+public:
+    TimeRunFlag() : id_(_NextId()) {}
+
+    void Add(std::unique_ptr<FlagFormatter> f)
+    {
+        flags_.push_back(std::move(f));
+    }
+
+    void format(LogMessage& msg, const std::tm&) override
+    {
+        std::time_t secs = log_clock::to_time_t(msg.time);
+        CacheEntry& entry = _Cache()[id_ % kCacheEntries];
+        if (entry.id == id_ && entry.secs == secs)
+        {
+            Append(msg.formatted, entry.text.data(), entry.text.size());
+            return;
+        }
+        std::tm tm_time = TimeZone::instance().LocalTime(secs);
+        std::size_t start = msg.formatted.size();
+        for (auto& f : flags_)
+        {
+            f->format(msg, tm_time);
+        }
+        entry.text.assign(msg.formatted.data() + start,
+                          msg.formatted.size() - start);
+        entry.id = id_;
+        entry.secs = secs;
+    }
+
+private:
+    static const std::size_t kCacheEntries = 8;
+
+    struct CacheEntry
+    {
+        CacheEntry() : id(0), secs(0) {}
+        std::uint64_t id;
+        std::time_t secs;
+        std::string text;
+    };
+
+    static CacheEntry* _Cache()
+    {
+        static thread_local CacheEntry t_cache[kCacheEntries];
+        return t_cache;
+    }
+
+    // cache key. unlike the address, never reused by a later run
+    static std::uint64_t _NextId()
+    {
+        static std::atomic<std::uint64_t> s_next_id(1);
+        return s_next_id++;
+    }
+
+    std::vector<std::unique_ptr<FlagFormatter>> flags_;
+    const std::uint64_t id_;
+};
+} // ns details
+
+class pattern_formatter : public formatter
+{
+public:
+    // eol false: no line ending is appended, for formatters which render
+    // a prefix with a pattern and append the rest themselves
+    explicit pattern_formatter(const std::string& pattern, bool eol = true);
+    pattern_formatter(const pattern_formatter&) = delete;
+    pattern_formatter& operator=(const pattern_formatter&) = delete;
+
+    void format(LogMessage& msg) override;
+
+private:
+    void _CompilePattern(const std::string& pattern,
+                         std::vector<details::FlagKind>& kinds);
+    void _HandleFlag(char flag, std::vector<details::FlagKind>& kinds);
+    void _AddFlag(details::FlagFormatter* f, details::FlagKind kind,
+                  std::vector<details::FlagKind>& kinds);
+    // merge runs of time flags and literals into TimeRunFlags
+    void _GroupTimeRuns(const std::vector<details::FlagKind>& kinds);
+
+    std::vector<std::unique_ptr<details::FlagFormatter>> formatters_;
+    bool eol_;
+};
+} // ns pb
+
+inline pb::pattern_formatter::pattern_formatter(const std::string& pattern,
+                                                bool eol) :
+    eol_(eol)
+{
+    std::vector<details::FlagKind> kinds;
+    _CompilePattern(pattern, kinds);
+    _GroupTimeRuns(kinds);
+}
+
+inline void pb::pattern_formatter::_CompilePattern(
+    const std::string& pattern, std::vector<details::FlagKind>& kinds)
+{
+    std::unique_ptr<details::LiteralFlag> literal;
+    for (auto it = pattern.begin(); it != pattern.end(); ++it)
+    {
+        if (*it == '%' && it + 1 != pattern.end() && *(it + 1) != '%')
+        {
+            if (literal)
+            {
+                _AddFlag(literal.release(), details::kLiteralKind, kinds);
+            }
+            _HandleFlag(*++it, kinds);
+            continue;
+        }
+        if (!literal)
+        {
+            literal.reset(new details::LiteralFlag());
+        }
+        literal->Add(*it);
+        if (*it == '%' && it + 1 != pattern.end())
+        {
+            ++it; // %%
+        }
+    }
+    if (literal)
+    {
+        _AddFlag(literal.release(), details::kLiteralKind, kinds);
+    }
+}
+
+inline void pb::pattern_formatter::_AddFlag(
+    details::FlagFormatter* f, details::FlagKind kind,
+    std::vector<details::FlagKind>& kinds)
+{
+    formatters_.emplace_back(f);
+    kinds.push_back(kind);
+}
+
+inline void pb::pattern_formatter::_HandleFlag(
+    char flag, std::vector<details::FlagKind>& kinds)
+{
+    using namespace details;
+    if (flag == '+')
+    {
+        _CompilePattern("[%Y-%m-%d %H:%M:%S.%e] [%n] [%l] ", kinds);
+        _AddFlag(new OptionalContextFlag(), kOtherKind, kinds);
+        _AddFlag(new MessageFlag(), kOtherKind, kinds);
+        return;
+    }
+    std::unique_ptr<FlagFormatter> f;
+    FlagKind kind = kTimeKind;
+    switch (flag)
+    {
+    case 'a': f.reset(new AbbrWeekdayFlag()); break;
+    case 'A': f.reset(new WeekdayFlag()); break;
+    case 'b':
+    case 'h': f.reset(new AbbrMonthFlag()); break;
+    case 'B': f.reset(new MonthFlag()); break;
+    case 'c': f.reset(new DateTimeFlag()); break;
+    case 'C': f.reset(new ShortYearFlag()); break;
+    case 'Y': f.reset(new YearFlag()); break;
+    case 'D':
+    case 'x': f.reset(new ShortDateFlag()); break;
+    case 'm': f.reset(new MonthNumFlag()); break;
+    case 'd': f.reset(new DayFlag()); break;
+    case 'H': f.reset(new HourFlag()); break;
+    case 'I': f.reset(new Hour12Flag()); break;
+    case 'M': f.reset(new MinuteFlag()); break;
+    case 'S': f.reset(new SecondFlag()); break;
+    case 'p': f.reset(new AmPmFlag()); break;
+    case 'r': f.reset(new Time12Flag()); break;
+    case 'R': f.reset(new HourMinuteFlag()); break;
+    case 'T': f.reset(new IsoTimeFlag()); break;
+    case 'z': f.reset(new UtcOffsetFlag()); break;
+    default: kind = kOtherKind; break;
+    }
+    if (!f)
+    {
+        switch (flag)
+        {
+        case 'e': f.reset(new SubSecondFlag<std::chrono::milliseconds, 3>()); break;
+        case 'f': f.reset(new SubSecondFlag<std::chrono::microseconds, 6>()); break;
+        case 'F': f.reset(new SubSecondFlag<std::chrono::nanoseconds, 9>()); break;
+        case 'l': f.reset(new LevelFlag()); break;
+        case 'L': f.reset(new ShortLevelFlag()); break;
+        case 'n': f.reset(new NameFlag()); break;
+        case 't': f.reset(new ThreadIdFlag()); break;
+        case 'P': f.reset(new PidFlag()); break;
+        case 'v': f.reset(new MessageFlag()); break;
+        case 'X': f.reset(new ContextFlag()); break;
+        default:
+        {
+            // unknown flag, kept as is
+            LiteralFlag* literal = new LiteralFlag();
+            f.reset(literal);
+            literal->Add('%');
+            literal->Add(flag);
+            kind = kLiteralKind;
+        }
+        }
+    }
+    _AddFlag(f.release(), kind, kinds);
+}
+
+inline void pb::pattern_formatter::_GroupTimeRuns(
+    const std::vector<details::FlagKind>& kinds)
+{
+    using namespace details;
+    std::vector<std::unique_ptr<FlagFormatter>> grouped;
+    std::size_t i = 0;
+    while (i < formatters_.size())
+    {
+        std::size_t end = i;
+        bool has_time = false;
+        while (end < formatters_.size() && kinds[end] != kOtherKind)
+        {
+            has_time = has_time || kinds[end] == kTimeKind;
+            ++end;
+        }
+        if (has_time)
+        {
+            TimeRunFlag* run = new TimeRunFlag();
+            grouped.emplace_back(run);
+            for (; i < end; ++i)
+            {
+                run->Add(std::move(formatters_[i]));
+            }
+            continue;
+        }
+        for (end = std::max(end, i + 1); i < end; ++i)
+        {
+            grouped.push_back(std::move(formatters_[i]));
+        }
+    }
+    formatters_.swap(grouped);
+}
+
+inline void pb::pattern_formatter::format(LogMessage& msg)
+{
+    // only the flags inside a TimeRunFlag use the broken down time, which
+    // the run computes itself, and only when the second changed
+    static const std::tm kNoTime = std::tm();
+    msg.level_start = msg.level_end = 0;
+    for (auto& f : formatters_)
+    {
+        f->format(msg, kNoTime);
+    }
+    if (eol_)
+    {
+        details::Append(msg.formatted, os::eol(), os::eol_size());
+    }
+}
+
+#endif // PB_LOG_PATTERN_FORMATTER_H_
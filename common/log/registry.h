@@ -0,0 +1,722 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-17 14:10:52
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-18 11:45:19
+*/
+
+#ifndef PB_LOG_REGISTRY_H_
+#define PB_LOG_REGISTRY_H_
+
+// Loggers registry behind pb::log::get/create/drop.
+// Lookups never lock: each shard publishes an immutable open addressing
+// table through an atomic pointer, writers (create/drop, rare) copy the
+// table under the registry mutex and publish the new version. A lookup reads
+// the table inside an Epoch::Guard (util/epoch.h), and a replaced version is
+// deleted by a later writer once no lookup can still be reading it.
+// Dropping a logger makes it unreachable by name and closes it: its async
+// worker and its sinks are released, but the object lives as long as the
+// registry and logs into nothing from then on. That is what lets
+// LoggerHandle be a plain pointer.
+// Names are identified by their 64 bit hash alone (a colliding name is
+// refused at creation), so a lookup with a precomputed LoggerKey does no
+// string work at all.
+// Dotted names form a hierarchy: a level set on "db" applies to "db.query"
+// and "db.pool.conn" unless they (or "db.pool") have a level of their own.
+// The effective level is resolved when the hierarchy changes and stored in
+// each logger, so ShouldLog never walks the tree.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <common/util/epoch.h>
+#include "common_def.h"
+#include "logger.h"
+#include "async_logger.h"
+#include "config.h"
+
+namespace pb
+{
+// FNV-1a. constexpr so names known at compile time are hashed at compile time
+constexpr std::uint64_t HashLoggerName(const char* name,
+                                       std::uint64_t h = 14695981039346656037ULL)
+{
+    return *name ? HashLoggerName(name + 1,
+        (h ^ static_cast<unsigned char>(*name)) * 1099511628211ULL) : h;
+}
+
+inline std::uint64_t HashLoggerName(const std::string& name)
+{
+    std::uint64_t h = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < name.size(); ++i)
+    {
+        h = (h ^ static_cast<unsigned char>(name[i])) * 1099511628211ULL;
+    }
+    return h;
+}
+
+// logger name with its hash computed once. from a string literal the hash is
+// a compile time constant:
+//
+// static constexpr pb::LoggerKey kDbKey("db.query");
+// pb::log::get(kDbKey)->info("...");
+class LoggerKey
+{
+public:
+    template <std::size_t N>
+    constexpr LoggerKey(const char (&name)[N]) :
+        name_(name), size_(N - 1), hash_(HashLoggerName(name)) {}
+
+    LoggerKey(const std::string& name) :
+        name_(name.c_str()), size_(name.size()),
+        hash_(HashLoggerName(name)) {}
+
+    // a name known at run time only. a template, so that a string literal
+    // still picks the constexpr constructor
+    template <typename T, typename = typename std::enable_if<
+                  std::is_convertible<T, const char*>::value &&
+                  !std::is_array<T>::value>::type>
+    LoggerKey(const T& name) :
+        name_(name), size_(std::char_traits<char>::length(name)),
+        hash_(HashLoggerName(name_)) {}
+
+    constexpr const char* name() const { return name_; }
+    constexpr std::size_t size() const { return size_; }
+    constexpr std::uint64_t hash() const { return hash_; }
+
+private:
+    const char* name_;
+    std::size_t size_;
+    std::uint64_t hash_;
+};
+
+// non owning reference to a registered logger. trivially copyable and
+// refcount free: copying or using one touches no shared cache line, so it
+// can be cached in a static local and passed around freely.
+// valid until the registry is destroyed at exit, even after a drop: a
+// dropped logger writes nothing.
+//
+// static const pb::LoggerHandle s_log = pb::log::handle("db.query");
+// s_log->info("...");
+class LoggerHandle
+{
+public:
+    constexpr LoggerHandle() : logger_(nullptr) {}
+    constexpr explicit LoggerHandle(Logger* logger) : logger_(logger) {}
+
+    Logger* operator->() const { return logger_; }
+    Logger& operator*() const { return *logger_; }
+    Logger* get() const { return logger_; }
+    explicit operator bool() const { return logger_ != nullptr; }
+
+private:
+    Logger* logger_;
+};
+
+class Registry
+{
+public:
+    static Registry& instance()
+    {
+        static Registry s_instance;
+        return s_instance;
+    }
+
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+
+    ~Registry()
+    {
+        for (auto& shard : shards_)
+        {
+            delete shard.table.load(std::memory_order_relaxed);
+        }
+    }
+
+    // lock free
+    std::shared_ptr<Logger> Get(const LoggerKey& key) const
+    {
+        std::uint64_t hash = _SlotHash(key.hash());
+        Epoch::Guard guard;
+        const Table* table = _ShardOf(hash).table.load(std::memory_order_acquire);
+        const Slot* slot = table ? table->Find(hash) : nullptr;
+        return slot ? slot->logger : std::shared_ptr<Logger>();
+    }
+
+    // lock free, and no refcount traffic. empty handle if not found
+    LoggerHandle GetHandle(const LoggerKey& key) const
+    {
+        std::uint64_t hash = _SlotHash(key.hash());
+        Epoch::Guard guard;
+        const Table* table = _ShardOf(hash).table.load(std::memory_order_acquire);
+        const Slot* slot = table ? table->Find(hash) : nullptr;
+        return LoggerHandle(slot ? slot->logger.get() : nullptr);
+    }
+
+    // apply the configured formatter and the inherited level to a new logger
+    // and register it. throws if the name (or its hash) is taken
+    void Register(const std::shared_ptr<Logger>& logger)
+    {
+        WriteLock lock(*this);
+        _Register(logger);
+    }
+
+    template <class It>
+    std::shared_ptr<Logger> Create(const std::string& logger_name,
+                                   const It& sinks_begin, const It& sinks_end)
+    {
+        WriteLock lock(*this);
+        std::shared_ptr<Logger> new_logger = _NewLogger(logger_name,
+                                                        sinks_begin, sinks_end);
+        _Register(new_logger);
+        return new_logger;
+    }
+
+    // apply a configuration (see config.h). patterns and sinks are built
+    // first, so a bad configuration throws without changing anything.
+    // the rest is applied under the registry mutex, so it doesn't interleave
+    // with other configuration changes. log calls don't take the mutex: the
+    // new settings (level, formatter, sinks) of every existing logger are
+    // staged, then put in effect together by one store. a concurrent log
+    // call sees either the old configuration or the new one, for all
+    // loggers. loggers the configuration creates are registered after that.
+    void Apply(const LogConfig& config)
+    {
+        WriteLock lock(*this);
+
+        formatter_ptr root_formatter = formatter_;
+        if (!config.pattern.empty())
+        {
+            root_formatter = std::make_shared<pattern_formatter>(config.pattern);
+        }
+        std::map<std::string, formatter_ptr> patterns = patterns_;
+        std::map<std::string, std::vector<sink_ptr>> new_loggers;
+        // sinks of existing loggers whose sink specs changed
+        std::map<std::string, std::vector<sink_ptr>> new_sinks;
+        for (const auto& entry : config.loggers)
+        {
+            const LoggerConfig& logger = entry.second;
+            if (!logger.pattern.empty())
+            {
+                patterns[entry.first] =
+                    std::make_shared<pattern_formatter>(logger.pattern);
+            }
+            if (logger.sinks.empty())
+            {
+                continue;
+            }
+            std::vector<sink_ptr>* sinks;
+            if (!loggers_.count(entry.first))
+            {
+                _CheckName(entry.first);
+                sinks = &new_loggers[entry.first];
+            }
+            else
+            {
+                auto specs = sink_specs_.find(entry.first);
+                if (specs != sink_specs_.end() && specs->second == logger.sinks)
+                {
+                    continue;
+                }
+                sinks = &new_sinks[entry.first];
+            }
+            for (const auto& spec : logger.sinks)
+            {
+                sinks->push_back(LogConfig::MakeSink(spec));
+            }
+        }
+        bool async_mode = async_mode_;
+        std::size_t async_q_size = async_q_size_;
+        AsyncOverflowPolicy overflow_policy = overflow_policy_;
+        if (config.has_async)
+        {
+            async_mode_ = config.async_queue_size != 0;
+            async_q_size_ = config.async_queue_size;
+            overflow_policy_ = config.overflow_policy;
+        }
+        std::vector<std::shared_ptr<Logger>> created;
+        try
+        {
+            for (auto& entry : new_loggers)
+            {
+                created.push_back(_NewLogger(entry.first, entry.second.begin(),
+                                             entry.second.end()));
+            }
+        }
+        catch (...)
+        {
+            async_mode_ = async_mode;
+            async_q_size_ = async_q_size;
+            overflow_policy_ = overflow_policy;
+            throw;
+        }
+
+        // nothing below throws
+        formatter_ = root_formatter;
+        patterns_.swap(patterns);
+        level_ = config.level;
+        levels_.clear();
+        for (const auto& entry : config.loggers)
+        {
+            if (entry.second.has_level)
+            {
+                levels_[entry.first] = entry.second.level;
+            }
+        }
+        for (const auto& entry : config.loggers)
+        {
+            if (!entry.second.sinks.empty())
+            {
+                sink_specs_[entry.first] = entry.second.sinks;
+            }
+        }
+        std::uint64_t generation = SettingsSlot::NextGeneration();
+        for (auto& l : loggers_)
+        {
+            Logger& logger = *l.second;
+            LoggerSettings settings = logger.settings_.current();
+            _Configure(l.first, settings);
+            auto sinks = new_sinks.find(l.first);
+            if (sinks != new_sinks.end())
+            {
+                settings.sinks.swap(sinks->second);
+            }
+            logger.settings_.Stage(settings, generation);
+            logger._UpdateLevel();
+        }
+        SettingsSlot::Commit(generation);
+        for (auto& l : loggers_)
+        {
+            l.second->_UpdateLevel();
+        }
+        for (auto& logger : created)
+        {
+            _Register(logger);
+        }
+    }
+
+    void Drop(const std::string& logger_name)
+    {
+        WriteLock lock(*this);
+        auto it = loggers_.find(logger_name);
+        if (it == loggers_.end())
+        {
+            return;
+        }
+        std::uint64_t hash = _SlotHash(HashLoggerName(logger_name));
+        Shard& shard = _ShardOf(hash);
+        _Publish(shard, _CopyTable(shard.table.load(std::memory_order_relaxed), hash));
+        closing_.push_back(it->second.get());
+        dropped_.push_back(std::move(it->second));
+        loggers_.erase(it);
+        sink_specs_.erase(logger_name);
+    }
+
+    void DropAll()
+    {
+        WriteLock lock(*this);
+        for (auto& shard : shards_)
+        {
+            _Retire(shard.table.exchange(nullptr, std::memory_order_acq_rel));
+        }
+        for (auto& l : loggers_)
+        {
+            closing_.push_back(l.second.get());
+            dropped_.push_back(std::move(l.second));
+        }
+        loggers_.clear();
+        sink_specs_.clear();
+    }
+
+    void set_formatter(formatter_ptr f)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        formatter_ = f;
+        patterns_.clear();
+        for (auto& l : loggers_)
+        {
+            l.second->set_formatter(formatter_);
+        }
+    }
+
+    void set_pattern(const std::string& pattern)
+    {
+        set_formatter(std::make_shared<pattern_formatter>(pattern));
+    }
+
+    // root level, inherited by every logger without a level in its ancestry
+    void set_level(LevelEnum log_level)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        level_ = log_level;
+        for (auto& l : loggers_)
+        {
+            l.second->set_level(_InheritedLevel(l.first));
+        }
+    }
+
+    // level of the logger_name subtree. an empty name is the root
+    void set_level(const std::string& logger_name, LevelEnum log_level)
+    {
+        if (logger_name.empty())
+        {
+            set_level(log_level);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        levels_[logger_name] = log_level;
+        _UpdateSubtree(logger_name);
+    }
+
+    // the subtree inherits from its parent again
+    void ResetLevel(const std::string& logger_name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (levels_.erase(logger_name))
+        {
+            _UpdateSubtree(logger_name);
+        }
+    }
+
+    void set_async_mode(std::size_t q_size,
+                        const AsyncOverflowPolicy overflow_policy,
+                        const std::function<void()>& worker_warmup_cb)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        async_mode_ = true;
+        async_q_size_ = q_size;
+        overflow_policy_ = overflow_policy;
+        worker_warmup_cb_ = worker_warmup_cb;
+    }
+
+    void set_sync_mode()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        async_mode_ = false;
+    }
+
+private:
+    static const std::size_t kShards = 16;
+
+    struct Slot
+    {
+        std::uint64_t hash;
+        std::shared_ptr<Logger> logger;
+    };
+
+    // immutable once published. power of two size, at most half full
+    struct Table
+    {
+        explicit Table(std::size_t capacity) :
+            mask(capacity - 1), size(0), slots(new Slot[capacity]()) {}
+
+        const Slot* Find(std::uint64_t hash) const
+        {
+            for (std::size_t i = hash & mask;; i = (i + 1) & mask)
+            {
+                const Slot& slot = slots[i];
+                if (slot.hash == hash)
+                {
+                    return &slot;
+                }
+                if (!slot.hash)
+                {
+                    return nullptr;
+                }
+            }
+        }
+
+        void Insert(std::uint64_t hash, const std::shared_ptr<Logger>& logger)
+        {
+            std::size_t i = hash & mask;
+            while (slots[i].hash)
+            {
+                i = (i + 1) & mask;
+            }
+            slots[i].hash = hash;
+            slots[i].logger = logger;
+            ++size;
+        }
+
+        std::size_t mask;
+        std::size_t size;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    // the registry mutex. what writers release while holding it (tables)
+    // is destroyed, and the loggers they drop are closed, after the unlock:
+    // closing waits for log calls in progress, flushes, joins the worker
+    // thread and may log. a logger must not be dropped from its own sinks
+    class WriteLock
+    {
+    public:
+        explicit WriteLock(Registry& registry) : registry_(registry)
+        {
+            registry_.mutex_.lock();
+        }
+
+        ~WriteLock()
+        {
+            std::vector<RetiredTable> tables;
+            std::vector<Logger*> loggers;
+            tables.swap(registry_.released_);
+            loggers.swap(registry_.closing_);
+            registry_.mutex_.unlock();
+            for (auto logger : loggers)
+            {
+                logger->_Close();
+            }
+        }
+
+        WriteLock(const WriteLock&) = delete;
+        WriteLock& operator=(const WriteLock&) = delete;
+
+    private:
+        Registry& registry_;
+    };
+
+    // cache line aligned so lookups in one shard don't share a line with
+    // writes to another
+    struct alignas(64) Shard
+    {
+        Shard() : table(nullptr) {}
+        // owned by the shard
+        std::atomic<const Table*> table;
+    };
+
+    // a replaced table and the Epoch stamp it was retired with
+    struct RetiredTable
+    {
+        std::uint64_t stamp;
+        std::unique_ptr<const Table> table;
+    };
+
+    Registry() :
+        level_(kInfo),
+        async_mode_(false),
+        async_q_size_(0),
+        overflow_policy_(AsyncOverflowPolicy::kBlockRetry) {}
+
+    // 0 marks an empty slot
+    static std::uint64_t _SlotHash(std::uint64_t hash)
+    {
+        return hash ? hash : 1;
+    }
+
+    // the top bits pick the shard, the low bits the table slot
+    Shard& _ShardOf(std::uint64_t hash)
+    {
+        return shards_[hash >> 60];
+    }
+    const Shard& _ShardOf(std::uint64_t hash) const
+    {
+        return shards_[hash >> 60];
+    }
+
+    // copy of the table without the entry for skip_hash
+    static std::unique_ptr<Table> _CopyTable(const Table* table,
+                                             std::uint64_t skip_hash,
+                                             std::size_t extra = 0)
+    {
+        std::size_t size = table ? table->size + extra : extra;
+        std::size_t capacity = 8;
+        while (capacity < size * 2)
+        {
+            capacity <<= 1;
+        }
+        std::unique_ptr<Table> copy(new Table(capacity));
+        if (table)
+        {
+            for (std::size_t i = 0; i <= table->mask; ++i)
+            {
+                const Slot& slot = table->slots[i];
+                if (slot.hash && slot.hash != skip_hash)
+                {
+                    copy->Insert(slot.hash, slot.logger);
+                }
+            }
+        }
+        return copy;
+    }
+
+    // called with mutex_ held
+    void _Publish(Shard& shard, std::unique_ptr<Table> table)
+    {
+        _Retire(shard.table.exchange(table.release(), std::memory_order_acq_rel));
+    }
+
+    // called with mutex_ held
+    void _Retire(const Table* table)
+    {
+        if (table)
+        {
+            RetiredTable retired;
+            retired.stamp = Epoch::Global().Retire();
+            retired.table.reset(table);
+            retired_.push_back(std::move(retired));
+        }
+        // stamps grow along retired_
+        std::size_t n = 0;
+        while (n < retired_.size() && Epoch::Global().Quiescent(retired_[n].stamp))
+        {
+            ++n;
+        }
+        std::move(retired_.begin(), retired_.begin() + n,
+                  std::back_inserter(released_));
+        retired_.erase(retired_.begin(), retired_.begin() + n);
+    }
+
+    // called with mutex_ held
+    template <class It>
+    std::shared_ptr<Logger> _NewLogger(const std::string& logger_name,
+                                       const It& sinks_begin, const It& sinks_end)
+    {
+        if (async_mode_)
+        {
+            return std::make_shared<AsyncLogger>(logger_name, sinks_begin,
+                sinks_end, async_q_size_, overflow_policy_, worker_warmup_cb_);
+        }
+        return std::make_shared<Logger>(logger_name, sinks_begin, sinks_end);
+    }
+
+    // throws if the name (or its hash) is taken. called with mutex_ held
+    void _CheckName(const std::string& logger_name) const
+    {
+        if (loggers_.count(logger_name))
+        {
+            throw SimpleException("logger with name '" + logger_name
+                                  + "' already exists");
+        }
+        std::uint64_t hash = _SlotHash(HashLoggerName(logger_name));
+        const Table* table = _ShardOf(hash).table.load(std::memory_order_relaxed);
+        const Slot* slot = table ? table->Find(hash) : nullptr;
+        if (slot)
+        {
+            throw SimpleException("logger name '" + logger_name
+                                  + "' collides with an existing logger name");
+        }
+    }
+
+    // configured formatter and inherited level. called with mutex_ held
+    void _Configure(const std::string& logger_name, LoggerSettings& settings)
+    {
+        auto it = patterns_.find(logger_name);
+        if (it != patterns_.end())
+        {
+            settings.formatter = it->second;
+        }
+        else if (formatter_)
+        {
+            settings.formatter = formatter_;
+        }
+        settings.level = _InheritedLevel(logger_name);
+    }
+
+    // called with mutex_ held
+    void _Register(const std::shared_ptr<Logger>& logger)
+    {
+        const std::string& logger_name = logger->name();
+        _CheckName(logger_name);
+        std::uint64_t hash = _SlotHash(HashLoggerName(logger_name));
+        Shard& shard = _ShardOf(hash);
+        const Table* table = shard.table.load(std::memory_order_relaxed);
+        logger->settings_.Update([this, &logger_name](LoggerSettings& settings)
+        {
+            _Configure(logger_name, settings);
+        });
+        logger->_UpdateLevel();
+        std::unique_ptr<Table> copy = _CopyTable(table, hash, 1);
+        copy->Insert(hash, logger);
+        _Publish(shard, std::move(copy));
+        loggers_[logger_name] = logger;
+    }
+
+    // level of the closest ancestor (or the logger itself) with a level set.
+    // called with mutex_ held
+    LevelEnum _InheritedLevel(const std::string& logger_name) const
+    {
+        std::string name = logger_name;
+        for (;;)
+        {
+            auto it = levels_.find(name);
+            if (it != levels_.end())
+            {
+                return it->second;
+            }
+            std::size_t dot = name.rfind('.');
+            if (dot == std::string::npos)
+            {
+                return level_;
+            }
+            name.resize(dot);
+        }
+    }
+
+    // push the effective level to prefix and its descendants. they sort
+    // right after prefix in loggers_. called with mutex_ held
+    void _UpdateSubtree(const std::string& prefix)
+    {
+        for (auto it = loggers_.lower_bound(prefix);
+             it != loggers_.end() && !it->first.compare(0, prefix.size(), prefix);
+             ++it)
+        {
+            const std::string& name = it->first;
+            if (name.size() == prefix.size() || name[prefix.size()] == '.')
+            {
+                it->second->set_level(_InheritedLevel(name));
+            }
+        }
+    }
+
+    // serializes creation, drop and global settings. never taken by Get
+    std::mutex mutex_;
+    Shard shards_[kShards];
+    std::map<std::string, std::shared_ptr<Logger>> loggers_;
+    // replaced tables which lookups may still be reading, oldest first
+    std::vector<RetiredTable> retired_;
+    // to be destroyed by WriteLock, after the unlock
+    std::vector<RetiredTable> released_;
+    // dropped loggers, kept so that handles to them stay valid
+    std::vector<std::shared_ptr<Logger>> dropped_;
+    // dropped loggers to be closed by WriteLock, after the unlock
+    std::vector<Logger*> closing_;
+    formatter_ptr formatter_;
+    // formatters of single loggers, from a configuration
+    std::map<std::string, formatter_ptr> patterns_;
+    // sink specs a configuration last gave each logger
+    std::map<std::string, std::vector<std::string>> sink_specs_;
+    // root level and the levels set on subtrees
+    LevelEnum level_;
+    std::map<std::string, LevelEnum> levels_;
+    bool async_mode_;
+    std::size_t async_q_size_;
+    AsyncOverflowPolicy overflow_policy_;
+    std::function<void()> worker_warmup_cb_;
+};
+} // ns pb
+
+#endif // PB_LOG_REGISTRY_H_
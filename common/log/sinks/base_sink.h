@@ -32,6 +32,7 @@ namespace pb
 {
 // base sink templated over a mutex (either dummy or realy)
 // concrete implementation should only override the SinkIt method
+// (and SinkItBatch if it can write many records at once)
 // all locking is taken care of here so no locking needed by the implementators.
 template <class Mutex>
 class BaseSink : public Sink
@@ -48,8 +49,26 @@ public:
         std::lock_guard<Mutex>lock(mutex_);
         SinkIt(msg);
     }
+
+    void LogBatch(const LogMessage* const* msgs, std::size_t count) override
+    {
+        std::lock_guard<Mutex>lock(mutex_);
+        SinkItBatch(msgs, count);
+    }
 protected:
     virtual void SinkIt(const LogMessage &msg) = 0;
+
+    // called with the lock held. must skip records below the sink level
+    virtual void SinkItBatch(const LogMessage* const* msgs, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (this->ShouldLog(msgs[i]->level))
+            {
+                SinkIt(*msgs[i]);
+            }
+        }
+    }
     Mutex mutex_;
 };
 }
@@ -0,0 +1,198 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-26 09:40:03
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-26 17:12:58
+*/
+
+#ifndef PB_LOG_SINKS_BINARY_FILE_SINK_H_
+#define PB_LOG_SINKS_BINARY_FILE_SINK_H_
+
+// File sink writing the binary format of binary_format.h.
+//
+// Records logged with PB_LOG_BIN are not formatted at all: the record is
+// the call site id, a time delta and the raw argument bytes, and the format
+// string goes to the file once per site. tools/binlog_decoder.cc turns the
+// file back into text with a pattern_formatter.
+// Messages which reach the sink through a logger were already formatted by
+// the caller; they are written as text records, so one file can take both.
+//
+// Example:
+//
+// auto bin = std::make_shared<pb::BinaryFileSinkMt>("trade.binlog", "trade");
+// PB_LOG_BIN(bin, pb::kInfo, "order {} filled {} @ {}", id, qty, price);
+// ...
+// $ binlog_decoder -p "[%H:%M:%S.%f] [%l] %v" trade.binlog
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <common/io/file_helper.h>
+#include <common/util/null_mutex.h>
+#include <common/util/os_spec.h>
+#include <common/log/binary_format.h>
+#include <common/log/call_site.h>
+#include "base_sink.h"
+
+namespace pb
+{
+template <class Mutex>
+class BinaryFileSink : public BaseSink<Mutex>
+{
+public:
+    // logger_name is what %n shows for the PB_LOG_BIN records
+    explicit BinaryFileSink(const std::string& filename,
+                            const std::string& logger_name = "",
+                            bool force_flush = false) :
+        file_helper_(force_flush)
+    {
+        file_helper_.Open(filename);
+        last_time_ = _Nanos(log_clock::now());
+        binlog::BeginFrame(out_, binlog::kHeader);
+        out_.append(binlog::kMagic, sizeof(binlog::kMagic));
+        binlog::PutFixed64(out_, static_cast<std::uint64_t>(last_time_));
+        binlog::PutVarint(out_, static_cast<std::uint64_t>(os::pid()));
+        binlog::PutString(out_, logger_name.data(), logger_name.size());
+        binlog::EndFrame(out_, 0);
+        file_helper_.Write(out_.data(), out_.size());
+    }
+
+    // write one record of the given call site (use PB_LOG_BIN). the
+    // arguments are encoded before the lock is taken
+    template <typename... Args>
+    void LogBinary(CallSite& site, const char* format, const Args&... args)
+    {
+        static_assert(sizeof...(Args) <= binlog::kMaxArgs,
+                      "PB_LOG_BIN takes at most 64 arguments");
+        unsigned id = site.Id(format);
+        std::int64_t now = _Nanos(log_clock::now());
+        std::string& arg_bytes = _ArgBuffer();
+        std::string& types = _TypeBuffer();
+        arg_bytes.clear();
+        types.clear();
+        binlog::details::EncodeArgs(arg_bytes, types, args...);
+
+        std::lock_guard<Mutex> lock(this->mutex_);
+        out_.clear();
+        if (id >= sites_.size() || !sites_[id])
+        {
+            _PutSite(site, format, types);
+        }
+        std::size_t start = out_.size();
+        binlog::BeginFrame(out_, binlog::kEvent);
+        binlog::PutVarint(out_, id);
+        binlog::PutVarint(out_, binlog::ZigZag(now - last_time_));
+        binlog::PutVarint(out_, os::thread_id());
+        out_.append(arg_bytes);
+        binlog::EndFrame(out_, start);
+        last_time_ = now;
+        file_helper_.Write(out_.data(), out_.size());
+    }
+
+    // records carry the raw text, the formatter isn't needed
+    bool UsesFormatted() const override { return false; }
+
+protected:
+    void SinkIt(const LogMessage& msg) override
+    {
+        std::int64_t time = _Nanos(msg.time);
+        out_.clear();
+        binlog::BeginFrame(out_, binlog::kText);
+        out_.push_back(static_cast<char>(msg.level));
+        binlog::PutVarint(out_, binlog::ZigZag(time - last_time_));
+        binlog::PutVarint(out_, msg.thread_id);
+        binlog::PutString(out_, msg.logger_name.data(), msg.logger_name.size());
+        binlog::PutString(out_, msg.raw.data(), msg.raw.size());
+        binlog::EndFrame(out_, 0);
+        last_time_ = time;
+        file_helper_.Write(out_.data(), out_.size());
+    }
+
+private:
+    static std::int64_t _Nanos(log_clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            t.time_since_epoch()).count();
+    }
+
+    // per thread, so encoding doesn't allocate once warmed up
+    static std::string& _ArgBuffer()
+    {
+        static thread_local std::string t_buf;
+        return t_buf;
+    }
+
+    static std::string& _TypeBuffer()
+    {
+        static thread_local std::string t_types;
+        return t_types;
+    }
+
+    // appends the site record to out_. called with the lock held
+    void _PutSite(const CallSite& site, const char* format,
+                  const std::string& types)
+    {
+        std::size_t start = out_.size();
+        binlog::BeginFrame(out_, binlog::kSite);
+        binlog::PutVarint(out_, site.id());
+        out_.push_back(static_cast<char>(site.level()));
+        binlog::PutVarint(out_, static_cast<std::uint64_t>(site.line()));
+        binlog::PutString(out_, site.file(), std::strlen(site.file()));
+        binlog::PutString(out_, site.function(), std::strlen(site.function()));
+        binlog::PutString(out_, format, std::strlen(format));
+        binlog::PutString(out_, types.data(), types.size());
+        binlog::EndFrame(out_, start);
+        if (site.id() >= sites_.size())
+        {
+            sites_.resize(site.id() + 1);
+        }
+        sites_[site.id()] = true;
+    }
+
+    FileHelper file_helper_;
+    // time of the last record written, ns since epoch
+    std::int64_t last_time_;
+    // sites whose record is in the file, by id
+    std::vector<bool> sites_;
+    // frames being written
+    std::string out_;
+};
+
+typedef BinaryFileSink<std::mutex> BinaryFileSinkMt;
+typedef BinaryFileSink<NullMutex> BinaryFileSinkSt;
+} // ns pb
+
+// log to a BinaryFileSink without formatting. level must be a constant:
+// it is recorded once per call site. arguments are checked as far as they
+// are when formatted as text: a null const char* throws fmt::FormatError
+// and nothing is written. errors in the format string itself only show
+// when the file is decoded
+#define PB_LOG_BIN(sink, level, format, ...) \
+    do \
+    { \
+        static pb::CallSite pb_call_site_(__FILE__, __func__, __LINE__, level); \
+        if ((sink)->ShouldLog(level)) \
+        { \
+            (sink)->LogBinary(pb_call_site_, format, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#endif // PB_LOG_SINKS_BINARY_FILE_SINK_H_
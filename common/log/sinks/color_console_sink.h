@@ -0,0 +1,182 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/* 
+* @Author: wangxiaobo
+* @Date:   2015-03-27 10:05:42
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-27 16:31:20
+*/
+
+#ifndef PB_LOG_SINKS_COLOR_CONSOLE_SINK_H_
+#define PB_LOG_SINKS_COLOR_CONSOLE_SINK_H_
+
+// Console sink writing with write(2) instead of std::cout.
+//
+// Whether the fd is a terminal is checked once, at construction:
+// - terminal: the level name (%l or %L, see LogMessage::level_start) is
+//   colored with pre-built ANSI sequences, and every message is written
+//   out at once (line buffered).
+// - otherwise (pipe, file): no colors, and messages are collected in a
+//   64KB buffer, written when it is full, on error and above, on Flush()
+//   and at destruction. Output of other writers to the same fd (printf,
+//   std::cout) may then come out of order with the log.
+// Colors are off on windows, whose older consoles don't take ANSI codes.
+//
+// Example:
+//
+// auto console = std::make_shared<pb::ColorConsoleSinkMt>(); // stdout
+// auto errors = std::make_shared<pb::ColorConsoleSinkMt>(2);  // stderr
+
+#include <mutex>
+#include <string>
+#include <common/util/null_mutex.h>
+#include <common/util/os_spec.h>
+#include "base_sink.h"
+
+namespace pb
+{
+template <class Mutex>
+class ColorConsoleSink : public BaseSink<Mutex>
+{
+public:
+    static const std::size_t kBufferSize = 64 * 1024;
+
+    explicit ColorConsoleSink(int fd = 1) :
+        fd_(fd),
+        tty_(os::is_tty(fd))
+    {
+        static const char* const kColors[] = {
+            "\033[37m", // trace: white
+            "\033[36m", // debug: cyan
+            "\033[32m", // info: green
+            "\033[1m", // notice: bold
+            "\033[33m\033[1m", // warning: bold yellow
+            "\033[31m\033[1m", // error: bold red
+            "\033[1m\033[41m", // critical: bold on red
+            "" // off
+        };
+        for (int i = kTrace; i <= kOff; ++i)
+        {
+            colors_[i] = kColors[i];
+        }
+#ifdef _WIN32
+        colored_ = false;
+#else
+        colored_ = tty_;
+#endif
+        if (!tty_)
+        {
+            buf_.reserve(kBufferSize);
+        }
+    }
+
+    ~ColorConsoleSink()
+    {
+        _Flush();
+    }
+
+    // write out what is buffered
+    void Flush()
+    {
+        std::lock_guard<Mutex> lock(this->mutex_);
+        _Flush();
+    }
+
+    // code is an escape sequence such as "\033[35m"
+    void set_color(LevelEnum level, const std::string& code)
+    {
+        std::lock_guard<Mutex> lock(this->mutex_);
+        colors_[level] = code;
+    }
+
+    bool tty() const { return tty_; }
+
+protected:
+    void SinkIt(const LogMessage& msg) override
+    {
+        _Append(msg);
+        if (tty_ || buf_.size() >= kBufferSize || msg.level >= kError)
+        {
+            _Flush();
+        }
+    }
+
+    // a batch goes out with one write, terminal or not
+    void SinkItBatch(const LogMessage* const* msgs, std::size_t count) override
+    {
+        bool flush = tty_;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const LogMessage& msg = *msgs[i];
+            if (this->ShouldLog(msg.level))
+            {
+                _Append(msg);
+                flush = flush || msg.level >= kError;
+                if (buf_.size() >= kBufferSize)
+                {
+                    _Flush();
+                }
+            }
+        }
+        if (flush)
+        {
+            _Flush();
+        }
+    }
+
+private:
+    void _Append(const LogMessage& msg)
+    {
+        const char* data = msg.formatted.data();
+        std::size_t size = msg.formatted.size();
+        std::size_t start = msg.level_start;
+        std::size_t end = msg.level_end;
+        if (!colored_ || start >= end || end > size)
+        {
+            buf_.append(data, size);
+            return;
+        }
+        static const char kReset[] = "\033[0m";
+        buf_.append(data, start);
+        buf_ += colors_[msg.level];
+        buf_.append(data + start, end - start);
+        buf_.append(kReset, sizeof(kReset) - 1);
+        buf_.append(data + end, size - end);
+    }
+
+    // a console which can't be written to isn't worth an exception: the
+    // text is dropped
+    void _Flush()
+    {
+        if (!buf_.empty())
+        {
+            os::write_all(fd_, buf_.data(), buf_.size());
+            buf_.clear();
+        }
+    }
+
+    const int fd_;
+    const bool tty_;
+    bool colored_;
+    std::string colors_[kOff + 1];
+    std::string buf_;
+};
+
+typedef ColorConsoleSink<std::mutex> ColorConsoleSinkMt;
+typedef ColorConsoleSink<NullMutex> ColorConsoleSinkSt;
+} // ns pb
+
+#endif // PB_LOG_SINKS_COLOR_CONSOLE_SINK_H_
@@ -23,11 +23,13 @@
 #ifndef PB_LOG_SINKS_FILE_SINK_H_
 #define PB_LOG_SINKS_FILE_SINK_H_
 
+#include <ctime>
 #include <mutex>
 #include <common/util/null_mutex.h>
 #include <common/io/file_helper.h>
 #include <common/util/format.h>
 #include <common/util/os_spec.h>
+#include <common/util/timezone.h>
 #include "base_sink.h"
 
 namespace pb
@@ -48,6 +50,11 @@ protected:
     {
         file_helper.Write(msg);
     }
+
+    void SinkItBatch(const LogMessage* const* msgs, std::size_t count) override
+    {
+        file_helper_.WriteBatch(msgs, count, this->level());
+    }
 private:
     FileHelper file_helper_;
 };
@@ -177,7 +184,7 @@ public:
 protected:
     void SinkIt(const LogMessage& msg) override
     {
-        if (std::chrono::system_clock::now() >= rotation_tp_)
+        if (msg.time >= rotation_tp_)
         {
             file_helper_.close();
             file_helper_.open(CalcFilename(base_filename_, extension_));
@@ -187,31 +194,31 @@ protected:
     }
 
 private:
+    // next rotation_h_:rotation_m_ local time. a day later is tomorrow's
+    // date at that time, not now + 24h, which is off on dst change days
     std::chrono::system_clock::time_point _NextRotationTp()
     {
         using namespace std::chrono;
+        TimeZone& tz = TimeZone::instance();
         auto now = system_clock::now();
-        time_t tnow = system_clock::to_time_t(now);
-        tm date = pb::os::localtime(tnow);
+        tm date = tz.LocalTime(system_clock::to_time_t(now));
         date.tm_hour = rotation_h_;
         date.tm_min = rotation_m_;
         date.tm_sec = 0;
-        auto rotation_time = system_clock::from_time_t(std::mktime(&date));
+        auto rotation_time = system_clock::from_time_t(tz.MakeTime(date));
         if (rotation_time > now)
         {
             return rotation_time;
         }
-        else
-        {
-            return system_clock::time_point(rotation_time + hours(24));
-        }
+        ++date.tm_mday;
+        return system_clock::from_time_t(tz.MakeTime(date));
     }
 
     //Create filename for the form basename.YYYY-MM-DD.extension
     static std::string CalcFilename(const std::string& basename,
                                     const std::string& extension)
     {
-        std::tm tm = pb::os::localtime();
+        std::tm tm = TimeZone::instance().LocalTime(std::time(nullptr));
         fmt::MemoryWriter w;
         w.write("{}_{:04d}-{:02d}-{:02d}_{:02d}-{:02d}.{}",
                 basename,
@@ -23,16 +23,67 @@
 #ifndef PB_LOG_SINKS_SINK_H_
 #define PB_LOG_SINKS_SINK_H_
 
+#include <atomic>
+#include <common/log/common_def.h>
 #include <common/log/log_message.h>
 
 namespace pb
 {
-// pure abstract base class
+// abstract base class
 class Sink
 {
 public:
+    Sink()
+    {
+        // no support under vs2013 for member initialization for std::atomic
+        level_ = kTrace;
+    }
     virtual ~Sink() {}
     virtual void Log(const LogMessage& msg) = 0;
+
+    // write a batch of records, skipping those below the sink level.
+    // records must come out contiguous, so sinks with a lock take it once
+    virtual void LogBatch(const LogMessage* const* msgs, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (ShouldLog(msgs[i]->level))
+            {
+                Log(*msgs[i]);
+            }
+        }
+    }
+
+    // messages below the sink level are not formatted nor passed to Log().
+    // loggers already holding this sink must be told with
+    // Logger::RefreshLevel() when the level is lowered.
+    void set_level(LevelEnum log_level)
+    {
+        level_.store(log_level, std::memory_order_relaxed);
+    }
+    LevelEnum level() const
+    {
+        return static_cast<LevelEnum>(level_.load(std::memory_order_relaxed));
+    }
+    bool ShouldLog(LevelEnum msg_level) const
+    {
+        return msg_level >= level_.load(std::memory_order_relaxed);
+    }
+
+    // sinks which only write LogMessage::raw return false, the logger then
+    // doesn't produce formatted text for them
+    virtual bool UsesFormatted() const { return true; }
+
+    // formatter for this sink only. nullptr (the default) means the owning
+    // logger's formatter. set it before the sink starts receiving messages.
+    void set_formatter(formatter_ptr sink_formatter)
+    {
+        formatter_ = sink_formatter;
+    }
+    const formatter_ptr& formatter() const { return formatter_; }
+protected:
+    formatter_ptr formatter_;
+    std::atomic_int level_;
 };
 }
 
@@ -39,5 +39,15 @@ public:
 
 typedef StdoutSink<NullMutex> StdoutSinkSt;
 typedef StdoutSink<std::mutex> StdoutSinkMt;
+
+template <class Mutex>
+class StderrSink : public OStreamSink<Mutex>
+{
+public:
+    StderrSink() : OStreamSink<Mutex>(std::cerr, true) {}
+};
+
+typedef StderrSink<NullMutex> StderrSinkSt;
+typedef StderrSink<std::mutex> StderrSinkMt;
 }
 #endif
\ No newline at end of file
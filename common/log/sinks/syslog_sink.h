@@ -37,7 +37,10 @@ namespace pb
 {
 // sink that write to syslog using syscall() library call.
 // locking is not needed, as syslog() itself is thread-safe.
-class SyslogSink : public sink
+// syslog adds its own time and priority, so by default the raw message is
+// sent and no formatting is done for this sink. set a formatter on the sink
+// to send formatted text instead.
+class SyslogSink : public Sink
 {
 public:
     SyslogSink(const std::string& ident = "", int syslog_option = 0,
@@ -64,8 +67,14 @@ public:
 
     void Log(const LogMessage& msg) override
     {
-        ::syslog(SyslogPriorityFromLevel(msg), "%s",
-                 msg.formatted.str().c_str());
+        const LogWriter& text = formatter_ ? msg.formatted : msg.raw;
+        ::syslog(SyslogPriorityFromLevel(msg), "%.*s",
+                 static_cast<int>(text.size()), text.data());
+    }
+
+    bool UsesFormatted() const override
+    {
+        return formatter_ != nullptr;
     }
 private:
     std::array<int, 10> priorities_;
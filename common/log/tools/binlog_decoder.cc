@@ -0,0 +1,335 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-26 14:27:31
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-26 20:03:46
+*/
+
+// Turns binary log files (sinks/binary_file_sink.h) back into text.
+//
+// usage: binlog_decoder [-p pattern] file...
+//
+// pattern is a pattern_formatter pattern, %+ by default. Corrupt bytes
+// are skipped up to the next frame with a valid crc, and reported on
+// stderr, as is a truncated last record; the exit status is then 1.
+// Record times are deltas, so the times after a lost record are off by
+// its delta until the next header.
+//
+// build: g++ -std=c++11 -I<repo root> common/log/tools/binlog_decoder.cc
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <common/util/format.h>
+#include <common/log/binary_format.h>
+#include <common/log/common_def.h>
+#include <common/log/log_message.h>
+#include <common/log/pattern_formatter.h>
+
+namespace pb
+{
+namespace binlog
+{
+class Decoder
+{
+public:
+    explicit Decoder(const std::string& pattern) :
+        formatter_(pattern),
+        has_header_(false),
+        time_(0) {}
+
+    // decode data (the content of file) to stdout. false if anything in it
+    // was corrupt
+    bool Decode(const std::string& data, const std::string& file);
+
+private:
+    struct Site
+    {
+        LevelEnum level;
+        std::string format;
+        std::string types;
+    };
+
+    bool _Record(int type, Reader& in);
+    bool _Event(Reader& in, LogMessage& msg);
+    bool _Text(Reader& in, LogMessage& msg);
+    void _Print(LogMessage& msg);
+
+    pattern_formatter formatter_;
+    bool has_header_;
+    // ns since epoch of the last record
+    std::int64_t time_;
+    std::string logger_name_;
+    std::map<std::uint64_t, Site> sites_;
+};
+} // ns binlog
+} // ns pb
+
+bool pb::binlog::Decoder::Decode(const std::string& data, const std::string& file)
+{
+    const char* p = data.data();
+    const std::size_t size = data.size();
+    has_header_ = false;
+    bool ok = true;
+    std::size_t pos = 0;
+    std::size_t skip_start = 0;
+    bool skipping = false;
+    while (pos < size)
+    {
+        bool valid = false;
+        std::size_t payload = 0;
+        if (size - pos >= kFrameOverhead)
+        {
+            Reader header(p + pos + 1, 4);
+            payload = header.GetFixed32();
+            if (payload <= size - pos - kFrameOverhead)
+            {
+                Reader crc(p + pos + kFrameHeaderSize + payload, 4);
+                valid = crc.GetFixed32() == Crc32(p + pos, kFrameHeaderSize + payload);
+            }
+        }
+        if (!valid)
+        {
+            if (!skipping)
+            {
+                skipping = true;
+                skip_start = pos;
+            }
+            ++pos;
+            continue;
+        }
+        if (skipping)
+        {
+            std::fprintf(stderr, "%s: skipped %zu corrupt bytes at offset %zu\n",
+                         file.c_str(), pos - skip_start, skip_start);
+            skipping = false;
+            ok = false;
+        }
+        Reader in(p + pos + kFrameHeaderSize, payload);
+        if (!_Record(static_cast<unsigned char>(p[pos]), in))
+        {
+            std::fprintf(stderr, "%s: bad record at offset %zu\n", file.c_str(), pos);
+            ok = false;
+        }
+        pos += kFrameOverhead + payload;
+    }
+    if (skipping)
+    {
+        std::fprintf(stderr, "%s: %zu bytes of corrupt or truncated data at offset %zu\n",
+                     file.c_str(), size - skip_start, skip_start);
+        ok = false;
+    }
+    return ok;
+}
+
+bool pb::binlog::Decoder::_Record(int type, Reader& in)
+{
+    if (type == kHeader)
+    {
+        const char* magic = in.GetBytes(sizeof(kMagic));
+        if (!magic || std::memcmp(magic, kMagic, sizeof(kMagic)))
+        {
+            return false;
+        }
+        time_ = static_cast<std::int64_t>(in.GetFixed64());
+        in.GetVarint(); // pid
+        fmt::StringRef name = in.GetString();
+        logger_name_.assign(name.c_str(), name.size());
+        sites_.clear();
+        has_header_ = in.ok();
+        return has_header_;
+    }
+    if (!has_header_)
+    {
+        return false;
+    }
+    if (type == kSite)
+    {
+        std::uint64_t id = in.GetVarint();
+        Site site;
+        site.level = static_cast<LevelEnum>(in.GetByte());
+        in.GetVarint(); // line
+        in.GetString(); // file
+        in.GetString(); // function
+        fmt::StringRef format = in.GetString();
+        fmt::StringRef types = in.GetString();
+        if (!in.ok() || site.level > kOff || types.size() > kMaxArgs)
+        {
+            return false;
+        }
+        site.format.assign(format.c_str(), format.size());
+        site.types.assign(types.c_str(), types.size());
+        sites_[id] = site;
+        return true;
+    }
+    LogMessage msg(kOff);
+    bool ok = false;
+    if (type == kEvent)
+    {
+        ok = _Event(in, msg);
+    }
+    else if (type == kText)
+    {
+        ok = _Text(in, msg);
+    }
+    if (ok)
+    {
+        _Print(msg);
+    }
+    return ok;
+}
+
+bool pb::binlog::Decoder::_Event(Reader& in, LogMessage& msg)
+{
+    typedef fmt::internal::Arg Arg;
+    auto site = sites_.find(in.GetVarint());
+    if (site == sites_.end())
+    {
+        return false;
+    }
+    time_ += UnZigZag(in.GetVarint());
+    msg.thread_id = static_cast<std::size_t>(in.GetVarint());
+
+    const std::string& types = site->second.types;
+    // the value before the arguments points to the extended type
+    // descriptor, which the site's types are (see fmt::ArgList)
+    fmt::internal::Value storage[kMaxArgs + 1];
+    storage[0].pointer = types.c_str();
+    fmt::internal::Value* values = storage + 1;
+    std::uint64_t packed_types = 0;
+    for (std::size_t i = 0; i < types.size(); ++i)
+    {
+        Arg::Type type = static_cast<Arg::Type>(types[i]);
+        fmt::internal::Value& value = values[i];
+        switch (type)
+        {
+        case Arg::INT:
+        case Arg::UINT:
+        case Arg::CHAR:
+            value.uint_value = in.GetFixed32();
+            break;
+        case Arg::LONG_LONG:
+        case Arg::ULONG_LONG:
+            value.ulong_long_value = in.GetFixed64();
+            break;
+        case Arg::DOUBLE:
+        {
+            std::uint64_t bits = in.GetFixed64();
+            std::memcpy(&value.double_value, &bits, sizeof(bits));
+            break;
+        }
+        case Arg::STRING:
+        {
+            fmt::StringRef s = in.GetString();
+            value.string.value = s.c_str();
+            value.string.size = s.size();
+            break;
+        }
+        case Arg::POINTER:
+            value.pointer = reinterpret_cast<const void*>(
+                static_cast<std::uintptr_t>(in.GetFixed64()));
+            break;
+        default:
+            return false;
+        }
+        if (i < fmt::ArgList::MAX_PACKED_ARGS)
+        {
+            packed_types |= static_cast<std::uint64_t>(type) << (4 * i);
+        }
+    }
+    if (!in.ok())
+    {
+        return false;
+    }
+    msg.level = site->second.level;
+    msg.logger_name = logger_name_;
+    try
+    {
+        msg.raw.write(site->second.format, fmt::ArgList(packed_types, values));
+    }
+    catch (const fmt::FormatError& ex)
+    {
+        msg.raw.clear();
+        msg.raw.write("[bad format: {}] {}", ex.what(), site->second.format);
+    }
+    return true;
+}
+
+bool pb::binlog::Decoder::_Text(Reader& in, LogMessage& msg)
+{
+    std::uint8_t level = in.GetByte();
+    time_ += UnZigZag(in.GetVarint());
+    msg.thread_id = static_cast<std::size_t>(in.GetVarint());
+    fmt::StringRef name = in.GetString();
+    fmt::StringRef text = in.GetString();
+    if (!in.ok() || level > kOff)
+    {
+        return false;
+    }
+    msg.level = static_cast<LevelEnum>(level);
+    msg.logger_name.assign(name.c_str(), name.size());
+    msg.raw << text;
+    return true;
+}
+
+void pb::binlog::Decoder::_Print(LogMessage& msg)
+{
+    msg.time = log_clock::time_point(std::chrono::duration_cast<log_clock::duration>(
+        std::chrono::nanoseconds(time_)));
+    formatter_.format(msg);
+    std::fwrite(msg.formatted.data(), 1, msg.formatted.size(), stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string pattern = "%+";
+    int first = 1;
+    if (argc > 2 && !std::strcmp(argv[1], "-p"))
+    {
+        pattern = argv[2];
+        first = 3;
+    }
+    if (first >= argc)
+    {
+        std::fprintf(stderr, "usage: %s [-p pattern] file...\n", argv[0]);
+        return 2;
+    }
+    pb::binlog::Decoder decoder(pattern);
+    int status = 0;
+    for (int i = first; i < argc; ++i)
+    {
+        std::ifstream in(argv[i], std::ios::in | std::ios::binary);
+        if (!in)
+        {
+            std::fprintf(stderr, "%s: can't open\n", argv[i]);
+            status = 1;
+            continue;
+        }
+        std::ostringstream data;
+        data << in.rdbuf();
+        if (!decoder.Decode(data.str(), argv[i]))
+        {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,174 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-28 10:12:40
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-28 16:05:19
+*/
+
+#ifndef PB_UTIL_ARENA_H_
+#define PB_UTIL_ARENA_H_
+
+// A per thread bump allocator for short lived buffers, such as the ones of
+// a log message which outgrow its inline storage.
+// Allocation moves a pointer up a block taken once per thread. Memory is
+// not reused piecemeal: the whole block is, as soon as nothing allocated
+// from it is live any more, so a thread which has one message at a time
+// starts over after each. When the block is full allocations fall back to
+// operator new.
+// An arena isn't thread safe: memory from it must be freed by the thread
+// which allocated it.
+
+#include <cstddef>
+#include <new>
+
+#ifndef PB_ARENA_SIZE
+#define PB_ARENA_SIZE (1024 * 1024)
+#endif
+
+namespace pb
+{
+class Arena
+{
+public:
+    explicit Arena(std::size_t size) :
+        begin_(nullptr), end_(nullptr), top_(nullptr), size_(size), live_(0) {}
+
+    ~Arena()
+    {
+        ::operator delete(begin_);
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // the calling thread's arena
+    static Arena& Local()
+    {
+        static thread_local Arena t_arena(PB_ARENA_SIZE);
+        return t_arena;
+    }
+
+    // size bytes aligned for any type, or nullptr when the block is full
+    void* Allocate(std::size_t size)
+    {
+        if (!begin_)
+        {
+            begin_ = top_ = static_cast<char*>(::operator new(size_));
+            end_ = begin_ + size_;
+        }
+        size = (size + kAlignment - 1) & ~(kAlignment - 1);
+        if (size > static_cast<std::size_t>(end_ - top_))
+        {
+            return nullptr;
+        }
+        void* p = top_;
+        top_ += size;
+        ++live_;
+        return p;
+    }
+
+    // false if p wasn't allocated from this arena
+    bool Deallocate(void* p, std::size_t size)
+    {
+        char* c = static_cast<char*>(p);
+        if (c < begin_ || c >= end_)
+        {
+            return false;
+        }
+        if (--live_ == 0)
+        {
+            top_ = begin_;
+        }
+        else if (c + ((size + kAlignment - 1) & ~(kAlignment - 1)) == top_)
+        {
+            // the last allocation, a writer giving up its buffer right after
+            // growing it is the common case
+            top_ = c;
+        }
+        return true;
+    }
+
+    // bytes in use, including ones freed out of order
+    std::size_t used() const
+    {
+        return static_cast<std::size_t>(top_ - begin_);
+    }
+
+private:
+    static const std::size_t kAlignment = 16;
+
+    char* begin_;
+    char* end_;
+    char* top_;
+    std::size_t size_;
+    std::size_t live_;
+};
+
+// std style allocator over the constructing thread's Arena, for
+// fmt::BasicMemoryWriter and the containers
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator() : arena_(&Arena::Local()) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(std::size_t n)
+    {
+        void* p = arena_->Allocate(n * sizeof(T));
+        if (!p)
+        {
+            p = ::operator new(n * sizeof(T));
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        if (!arena_->Deallocate(p, n * sizeof(T)))
+        {
+            ::operator delete(p);
+        }
+    }
+
+    Arena* arena() const
+    {
+        return arena_;
+    }
+
+private:
+    Arena* arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.arena() != b.arena();
+}
+} // ns pb
+
+#endif // PB_UTIL_ARENA_H_
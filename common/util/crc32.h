@@ -0,0 +1,86 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-25 10:21:07
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-25 11:48:30
+*/
+
+#ifndef PB_UTIL_CRC32_H_
+#define PB_UTIL_CRC32_H_
+
+// CRC-32 (IEEE 802.3, as in zlib and png), slicing by 4 bytes per step.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pb
+{
+namespace details
+{
+struct Crc32Table
+{
+    Crc32Table()
+    {
+        for (std::uint32_t i = 0; i < 256; ++i)
+        {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[0][i] = c;
+        }
+        for (std::uint32_t i = 0; i < 256; ++i)
+        {
+            for (int k = 1; k < 4; ++k)
+            {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+
+    std::uint32_t t[4][256];
+};
+} // ns details
+
+// crc of data, continuing from crc (the result of a previous call, 0 to
+// start)
+inline std::uint32_t Crc32(const void* data, std::size_t size,
+                           std::uint32_t crc = 0)
+{
+    static const details::Crc32Table s_table;
+    const std::uint32_t (&t)[4][256] = s_table.t;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (; size >= 4; size -= 4, p += 4)
+    {
+        crc ^= static_cast<std::uint32_t>(p[0]) | static_cast<std::uint32_t>(p[1]) << 8
+               | static_cast<std::uint32_t>(p[2]) << 16
+               | static_cast<std::uint32_t>(p[3]) << 24;
+        crc = t[3][crc & 0xFF] ^ t[2][(crc >> 8) & 0xFF]
+              ^ t[1][(crc >> 16) & 0xFF] ^ t[0][crc >> 24];
+    }
+    for (; size; --size, ++p)
+    {
+        crc = t[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+} // ns pb
+
+#endif // PB_UTIL_CRC32_H_
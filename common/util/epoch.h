@@ -0,0 +1,192 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-30 10:05:41
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-30 17:12:26
+*/
+
+#ifndef PB_UTIL_EPOCH_H_
+#define PB_UTIL_EPOCH_H_
+
+// Epoch based reclamation, for objects which readers use without a lock
+// while a writer may replace them (the logger registry tables, formatters).
+// A reader keeps an Epoch::Guard while it uses such an object. A writer
+// which has unpublished one takes a stamp with Retire() and deletes it once
+// Quiescent(stamp): by then every guard which could have seen it has ended.
+// Synchronize() waits for that instead, for writers which must release
+// something right away (closing a dropped logger's files).
+// Entering a guard is a store and a fence on a cache line of the calling
+// thread's own; guards nest.
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace pb
+{
+class Epoch
+{
+    struct Record;
+
+public:
+    // never destroyed: threads may leave their guards after static
+    // destructors have run
+    static Epoch& Global()
+    {
+        static Epoch* s_epoch = new Epoch;
+        return *s_epoch;
+    }
+
+    Epoch(const Epoch&) = delete;
+    Epoch& operator=(const Epoch&) = delete;
+
+    class Guard
+    {
+    public:
+        Guard() : record_(Epoch::Global()._Local())
+        {
+            if (!record_->depth++)
+            {
+                record_->epoch.store(
+                    Epoch::Global().global_.load(std::memory_order_acquire),
+                    std::memory_order_relaxed);
+                // the epoch must be visible before the protected pointer is
+                // loaded
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        ~Guard()
+        {
+            if (!--record_->depth)
+            {
+                record_->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        Record* record_;
+    };
+
+    // stamp for objects which have just been unpublished
+    std::uint64_t Retire()
+    {
+        return global_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // true once no guard entered before Retire() returned stamp is left
+    bool Quiescent(std::uint64_t stamp) const
+    {
+        return _Quiescent(stamp, nullptr);
+    }
+
+    // waits until every guard entered before the call has ended. a guard
+    // the calling thread is in is not waited for: whatever it uses must not
+    // be what the caller is about to release
+    void Synchronize()
+    {
+        const Record* self = _Local();
+        std::uint64_t stamp = Retire();
+        while (!_Quiescent(stamp, self))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    // one per thread, reused after the thread exits. epoch 0 is outside a
+    // guard. padded so that the epochs of two threads never share a cache
+    // line (operator new doesn't honour alignas before C++17)
+    struct Record
+    {
+        Record() : epoch(0), used(true), depth(0), next(nullptr) {}
+
+        std::atomic<std::uint64_t> epoch;
+        std::atomic<bool> used;
+        unsigned depth;
+        Record* next;
+        char pad[64];
+    };
+
+    // gives the record back when its thread exits
+    struct LocalRecord
+    {
+        explicit LocalRecord(Record* r) : record(r) {}
+        ~LocalRecord()
+        {
+            record->used.store(false, std::memory_order_release);
+        }
+
+        Record* record;
+    };
+
+    Epoch() : global_(1), records_(nullptr) {}
+
+    bool _Quiescent(std::uint64_t stamp, const Record* skip) const
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (const Record* r = records_.load(std::memory_order_acquire); r;
+             r = r->next)
+        {
+            std::uint64_t epoch = r->epoch.load(std::memory_order_seq_cst);
+            if (r != skip && epoch && epoch <= stamp)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Record* _Local()
+    {
+        static thread_local LocalRecord t_record(_Acquire());
+        return t_record.record;
+    }
+
+    Record* _Acquire()
+    {
+        Record* head = records_.load(std::memory_order_acquire);
+        for (Record* r = head; r; r = r->next)
+        {
+            bool used = false;
+            if (!r->used.load(std::memory_order_relaxed) &&
+                r->used.compare_exchange_strong(used, true,
+                                                std::memory_order_acquire))
+            {
+                return r;
+            }
+        }
+        // records are never freed, the list only grows at the head
+        Record* r = new Record;
+        r->next = head;
+        while (!records_.compare_exchange_weak(r->next, r,
+                                               std::memory_order_release))
+        {
+        }
+        return r;
+    }
+
+    std::atomic<std::uint64_t> global_;
+    std::atomic<Record*> records_;
+};
+} // ns pb
+
+#endif // PB_UTIL_EPOCH_H_
@@ -0,0 +1,188 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-23 09:55:14
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-23 15:31:47
+*/
+
+#ifndef PB_UTIL_ESCAPE_H_
+#define PB_UTIL_ESCAPE_H_
+
+// String escaping for structured log output (JSON and logfmt).
+// The scan for bytes which need escaping looks at 16 bytes per step with
+// SSE2 where available; runs of clean bytes are then copied with a single
+// append.
+
+#include <cstddef>
+#include <common/util/format.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PB_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace pb
+{
+namespace details
+{
+#ifdef _MSC_VER
+inline unsigned CountTrailingZeros(unsigned mask)
+{
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+}
+#else
+inline unsigned CountTrailingZeros(unsigned mask)
+{
+    return static_cast<unsigned>(__builtin_ctz(mask));
+}
+#endif
+
+// offset of the first byte of s which is <= max_control or one of a, b, c,
+// or size if there is none
+inline std::size_t FindSpecial(const char* s, std::size_t size,
+                               unsigned char max_control, char a, char b, char c)
+{
+    std::size_t i = 0;
+#ifdef PB_HAVE_SSE2
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    const __m128i vmax = _mm_set1_epi8(static_cast<char>(max_control));
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        // x <= max_control (unsigned) <=> max(x, max_control) == max_control
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, vc),
+                         _mm_cmpeq_epi8(_mm_max_epu8(v, vmax), vmax)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask)
+        {
+            return i + CountTrailingZeros(mask);
+        }
+    }
+#endif
+    for (; i < size; ++i)
+    {
+        unsigned char x = static_cast<unsigned char>(s[i]);
+        if (x <= max_control || s[i] == a || s[i] == b || s[i] == c)
+        {
+            return i;
+        }
+    }
+    return size;
+}
+} // ns details
+
+// offset of the first byte of s which must be escaped in a JSON string
+// (control characters, '"' and '\'), or size if there is none
+inline std::size_t FindJsonSpecial(const char* s, std::size_t size)
+{
+    return details::FindSpecial(s, size, 0x1F, '"', '\\', '"');
+}
+
+// offset of the first byte of s which makes a logfmt value need quotes
+// (space, control characters, '=', '"' and '\'), or size if there is none
+inline std::size_t FindLogfmtSpecial(const char* s, std::size_t size)
+{
+    return details::FindSpecial(s, size, ' ', '=', '"', '\\');
+}
+
+// append s to w as the inside of a JSON string. bytes >= 0x80 are copied
+// as is, so valid UTF-8 stays valid
+inline void JsonEscape(fmt::Writer& w, const char* s, std::size_t size)
+{
+    static const char kHex[] = "0123456789abcdef";
+    while (size)
+    {
+        std::size_t clean = FindJsonSpecial(s, size);
+        if (clean)
+        {
+            w << fmt::StringRef(s, clean);
+            s += clean;
+            size -= clean;
+            if (!size)
+            {
+                return;
+            }
+        }
+        unsigned char c = static_cast<unsigned char>(*s++);
+        --size;
+        switch (c)
+        {
+        case '"': w << fmt::StringRef("\\\"", 2); break;
+        case '\\': w << fmt::StringRef("\\\\", 2); break;
+        case '\n': w << fmt::StringRef("\\n", 2); break;
+        case '\r': w << fmt::StringRef("\\r", 2); break;
+        case '\t': w << fmt::StringRef("\\t", 2); break;
+        case '\b': w << fmt::StringRef("\\b", 2); break;
+        case '\f': w << fmt::StringRef("\\f", 2); break;
+        default:
+        {
+            char u[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+            w << fmt::StringRef(u, 6);
+        }
+        }
+    }
+}
+
+// append s to w as a logfmt value: as is when it can be, else quoted with
+// the same escapes as JSON. empty values are written as ""
+inline void LogfmtValue(fmt::Writer& w, const char* s, std::size_t size)
+{
+    if (size && FindLogfmtSpecial(s, size) == size)
+    {
+        w << fmt::StringRef(s, size);
+        return;
+    }
+    w << '"';
+    JsonEscape(w, s, size);
+    w << '"';
+}
+
+// append s to w as a logfmt key. keys can't be quoted, so bytes which
+// would need quotes are replaced by '_', and so is an empty key
+inline void LogfmtKey(fmt::Writer& w, const char* s, std::size_t size)
+{
+    if (!size)
+    {
+        w << '_';
+        return;
+    }
+    while (size)
+    {
+        std::size_t clean = FindLogfmtSpecial(s, size);
+        w << fmt::StringRef(s, clean);
+        if (clean == size)
+        {
+            return;
+        }
+        w << '_';
+        s += clean + 1;
+        size -= clean + 1;
+    }
+}
+} // ns pb
+
+#endif // PB_UTIL_ESCAPE_H_
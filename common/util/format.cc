@@ -58,6 +58,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <climits>
 #include <cmath>
 #include <cstdarg>
+#include <cstring>
 
 #ifdef _WIN32
 # ifndef WIN32_LEAN_AND_MEAN
@@ -69,6 +70,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 # include <windows.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define FMT_USE_SSE2 1
+# include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+# include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
 using pb::fmt::LongLong;
 using pb::fmt::ULongLong;
 using pb::fmt::internal::Arg;
@@ -243,6 +255,131 @@ FMT_FUNC int parse_nonnegative_int(const Char *&s) {
     return value;
 }
 
+template <typename Char>
+inline bool is_name_start(Char c) {
+    return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_';
+}
+
+// Parses an argument name, [A-Za-z_][A-Za-z0-9_]*, advancing s to the end
+// of the parsed input. This function assumes that is_name_start(*s).
+template <typename Char>
+inline pb::fmt::BasicStringRef<Char> parse_arg_name(const Char *&s) {
+    assert(is_name_start(*s));
+    const Char *start = s;
+    Char c;
+    do {
+        c = *++s;
+    } while (is_name_start(c) || ('0' <= c && c <= '9'));
+    return pb::fmt::BasicStringRef<Char>(start, s - start);
+}
+
+// Returns a pointer to the first '{', '}' or null character in [s, end) or
+// end if there is none.
+template <typename Char>
+inline const Char *find_brace(const Char *s, const Char *end) {
+    while (s < end && *s != '{' && *s != '}' && *s)
+        ++s;
+    return s < end ? s : end;
+}
+
+#if FMT_USE_SSE2
+inline unsigned count_trailing_zeros(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Looks at 32 bytes per step with AVX2, 16 with SSE2, so that long literal
+// text costs little more than the copy of it.
+template <>
+inline const char *find_brace(const char *s, const char *end) {
+#ifdef __AVX2__
+    const __m256i open32 = _mm256_set1_epi8('{');
+    const __m256i close32 = _mm256_set1_epi8('}');
+    const __m256i zero32 = _mm256_setzero_si256();
+    for (; end - s >= 32; s += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+        __m256i found = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, open32),
+                            _mm256_cmpeq_epi8(v, close32)),
+            _mm256_cmpeq_epi8(v, zero32));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(found));
+        if (mask)
+            return s + count_trailing_zeros(mask);
+    }
+#endif
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i zero = _mm_setzero_si128();
+    for (; end - s >= 16; s += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        __m128i found = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, open), _mm_cmpeq_epi8(v, close)),
+            _mm_cmpeq_epi8(v, zero));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(found));
+        if (mask)
+            return s + count_trailing_zeros(mask);
+    }
+    while (s < end && *s != '{' && *s != '}' && *s)
+        ++s;
+    return s < end ? s : end;
+}
+#endif
+
+// Checks if arg is a named argument with specified name.
+template <typename Char>
+inline bool is_named_arg(const Arg &arg, pb::fmt::BasicStringRef<Char> name) {
+    if (arg.type != Arg::NAMED_ARG)
+        return false;
+    const pb::fmt::internal::NamedArg<Char> *named =
+        static_cast<const pb::fmt::internal::NamedArg<Char>*>(
+            static_cast<const Arg*>(arg.pointer));
+    return named->name.size() == name.size() &&
+        std::char_traits<Char>::compare(
+            named->name.c_str(), name.c_str(), name.size()) == 0;
+}
+
+// Returns the named argument with specified name or an argument of type
+// NONE. It is kept out of line and takes the list by value, so that a
+// formatter which never sees a name pays nothing for them.
+template <typename Char>
+FMT_NOINLINE Arg find_named_arg(
+    pb::fmt::ArgList args, pb::fmt::BasicStringRef<Char> name) {
+    for (unsigned i = 0; ; ++i) {
+        Arg arg = args[i];
+        if (arg.type == Arg::NONE)
+            return arg;
+        if (is_named_arg(arg, name))
+            return *static_cast<const Arg*>(arg.pointer);
+    }
+}
+
+// Returns the index of the named argument with specified name or UINT_MAX.
+template <typename Char>
+unsigned find_named_arg_index(
+    const pb::fmt::ArgList &args, pb::fmt::BasicStringRef<Char> name) {
+    for (unsigned i = 0; ; ++i) {
+        Arg arg = args[i];
+        if (arg.type == Arg::NONE)
+            return UINT_MAX;
+        if (is_named_arg(arg, name))
+            return i;
+    }
+}
+
+template <typename Char>
+inline Arg get_named_arg(pb::fmt::ArgList args,
+    pb::fmt::BasicStringRef<Char> name, const char *&error) {
+    Arg arg = find_named_arg(args, name);
+    if (arg.type == Arg::NONE)
+        error = "argument not found";
+    return arg;
+}
+
 inline void require_numeric_argument(const Arg &arg, char spec) {
     if (arg.type > Arg::LAST_NUMERIC_TYPE) {
         std::string message =
@@ -453,6 +590,223 @@ const uint64_t pb::fmt::internal::BasicData<T>::POWERS_OF_10_64[] = {
     ULongLong(1000000000) * ULongLong(1000000000) * 10
 };
 
+#ifdef __SIZEOF_INT128__
+namespace {
+typedef unsigned __int128 uint128;
+
+// 10^n for n <= 38.
+FMT_FUNC uint128 pow10_128(int n) {
+    typedef pb::fmt::internal::Data Data;
+    if (n == 0)
+        return 1;
+    if (n <= 19)
+        return Data::POWERS_OF_10_64[n];
+    return static_cast<uint128>(Data::POWERS_OF_10_64[19]) *
+           (n == 19 ? 1 : Data::POWERS_OF_10_64[n - 19]);
+}
+
+// Sets result to mantissa * 2^exp * 10^n rounded to the nearest integer,
+// ties to even (as printf does in the default rounding mode). Returns false
+// if an intermediate value doesn't fit in 127 bits.
+FMT_FUNC bool round_scaled(uint64_t mantissa, int exp, int n, uint128 &result) {
+    if (n > 22 || n < -38 || exp > 126 || exp < -126)
+        return false;
+    // mantissa < 2^53 and 10^22 < 2^74
+    uint128 num = n >= 0 ? mantissa * pow10_128(n) : mantissa;
+    if (n >= 0 && exp < 0) {
+        // the usual case: the denominator is a power of 2
+        unsigned shift = -exp;
+        result = num >> shift;
+        uint128 rem = num & ((static_cast<uint128>(1) << shift) - 1);
+        uint128 half = static_cast<uint128>(1) << (shift - 1);
+        if (rem > half || (rem == half && (result & 1)))
+            ++result;
+        return true;
+    }
+    uint128 den = n >= 0 ? 1 : pow10_128(-n);
+    if (exp >= 0) {
+        if (num >> (127 - exp))
+            return false;
+        num <<= exp;
+    } else {
+        if (den >> (127 + exp))
+            return false;
+        den <<= -exp;
+    }
+    result = num / den;
+    uint128 rem = num - result * den;
+    uint128 rest = den - rem;
+    if (rem > rest || (rem == rest && (result & 1)))
+        ++result;
+    return true;
+}
+
+// Writes the decimal digits of value to buffer (at least 40 chars) and
+// returns their count.
+FMT_FUNC int write_digits(char *buffer, uint128 value) {
+    char tmp[40];
+    char *p = tmp + sizeof(tmp);
+    // 128-bit division is a library call, use it only for the top digits
+    while (value >> 64) {
+        *--p = static_cast<char>('0' + static_cast<unsigned>(value % 10));
+        value /= 10;
+    }
+    uint64_t low = static_cast<uint64_t>(value);
+    while (low >= 100) {
+        unsigned index = static_cast<unsigned>(low % 100) * 2;
+        low /= 100;
+        *--p = pb::fmt::internal::Data::DIGITS[index + 1];
+        *--p = pb::fmt::internal::Data::DIGITS[index];
+    }
+    if (low >= 10) {
+        unsigned index = static_cast<unsigned>(low) * 2;
+        *--p = pb::fmt::internal::Data::DIGITS[index + 1];
+        *--p = pb::fmt::internal::Data::DIGITS[index];
+    } else {
+        *--p = static_cast<char>('0' + low);
+    }
+    int n = static_cast<int>(tmp + sizeof(tmp) - p);
+    std::memcpy(buffer, p, n);
+    return n;
+}
+
+// Writes digits as a number with the given count of decimals.
+FMT_FUNC char *write_fixed(char *out, const char *digits, int num_digits,
+                           int decimals) {
+    if (num_digits <= decimals) {
+        *out++ = '0';
+        *out++ = '.';
+        std::memset(out, '0', decimals - num_digits);
+        out += decimals - num_digits;
+        std::memcpy(out, digits, num_digits);
+        return out + num_digits;
+    }
+    int int_digits = num_digits - decimals;
+    std::memcpy(out, digits, int_digits);
+    out += int_digits;
+    if (decimals) {
+        *out++ = '.';
+        std::memcpy(out, digits + int_digits, decimals);
+        out += decimals;
+    }
+    return out;
+}
+
+// Writes d.ddd followed by e+XX (at least two exponent digits).
+FMT_FUNC char *write_exponent(char *out, const char *digits, int num_digits,
+                              int exp10, bool upper, bool strip_zeros) {
+    *out++ = digits[0];
+    if (num_digits > 1) {
+        *out++ = '.';
+        std::memcpy(out, digits + 1, num_digits - 1);
+        out += num_digits - 1;
+    }
+    if (strip_zeros) {
+        while (num_digits > 1 && out[-1] == '0')
+            --out;
+        if (out[-1] == '.')
+            --out;
+    }
+    *out++ = upper ? 'E' : 'e';
+    *out++ = exp10 < 0 ? '-' : '+';
+    unsigned abs_exp = exp10 < 0 ? -exp10 : exp10;
+    if (abs_exp >= 100)
+        *out++ = static_cast<char>('0' + abs_exp / 100);
+    *out++ = static_cast<char>('0' + abs_exp / 10 % 10);
+    *out++ = static_cast<char>('0' + abs_exp % 10);
+    return out;
+}
+}  // namespace
+#endif  // __SIZEOF_INT128__
+
+FMT_FUNC int pb::fmt::internal::format_float_native(
+        char *buffer, double value, char type, int precision) {
+#ifndef __SIZEOF_INT128__
+    (void)buffer;
+    (void)value;
+    (void)type;
+    (void)precision;
+    return -1;
+#else
+    if (precision < 0)
+        precision = 6;
+    if (precision > 38)
+        return -1;
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    int biased_exp = static_cast<int>(bits >> 52 & 0x7ff);
+    uint64_t mantissa = bits & ((ULongLong(1) << 52) - 1);
+    int exp = -1074;
+    if (biased_exp) {
+        mantissa |= ULongLong(1) << 52;
+        exp = biased_exp - 1075;
+    }
+
+    char digits[40];
+    uint128 scaled = 0;
+    char lower = static_cast<char>(type | 0x20);
+    if (lower == 'f') {
+        if (!round_scaled(mantissa, exp, precision, scaled))
+            return -1;
+        int num_digits = write_digits(digits, scaled);
+        return static_cast<int>(
+            write_fixed(buffer, digits, num_digits, precision) - buffer);
+    }
+
+    // precision significant digits, digits[0] being 10^exp10
+    if (lower == 'e')
+        ++precision;
+    else if (precision == 0)
+        precision = 1;
+    if (precision > 38)
+        return -1;
+    int exp10 = 0;
+    if (!mantissa) {
+        std::memset(digits, '0', precision);
+    } else {
+        // floor(log10(value)), or one less
+        int bit_length = 64 - __builtin_clzll(mantissa);
+        exp10 = static_cast<int>(
+            std::floor((bit_length - 1 + exp) * 0.30102999566398120));
+        uint128 min = pow10_128(precision - 1);
+        for (int tries = 0; ; ++tries) {
+            if (tries == 3 ||
+                !round_scaled(mantissa, exp, precision - 1 - exp10, scaled))
+                return -1;
+            // off by one, or rounding carried into a new digit (9.99 -> 10.0)
+            if (scaled < min)
+                --exp10;
+            else if (scaled >= min * 10)
+                ++exp10;
+            else
+                break;
+        }
+        write_digits(digits, scaled);
+    }
+    bool upper = type == 'E' || type == 'G';
+    if (lower == 'e') {
+        return static_cast<int>(write_exponent(
+            buffer, digits, precision, exp10, upper, false) - buffer);
+    }
+    if (exp10 < -4 || exp10 >= precision) {
+        return static_cast<int>(write_exponent(
+            buffer, digits, precision, exp10, upper, true) - buffer);
+    }
+    char *out = write_fixed(buffer, digits, precision, precision - 1 - exp10);
+    if (precision - 1 - exp10 > 0) {
+        while (out[-1] == '0')
+            --out;
+        if (out[-1] == '.')
+            --out;
+    }
+    return static_cast<int>(out - buffer);
+#endif  // __SIZEOF_INT128__
+}
+
+FMT_FUNC void pb::fmt::internal::report_buffer_overflow() {
+    FMT_THROW(pb::fmt::FormatError("output is too long for a fixed buffer"));
+}
+
 FMT_FUNC void pb::fmt::internal::report_unknown_type(char code, const char *type) {
     if (std::isprint(static_cast<unsigned char>(code))) {
         FMT_THROW(pb::fmt::FormatError(
@@ -657,14 +1011,24 @@ FMT_FUNC void pb::fmt::BasicWriter<Char>::write_str(
         if (*s)
             size = std::char_traits<StrChar>::length(s);
     }
-    write_str(s, size, spec);
+    // Appended rather than copied to a grown area, so that a fixed buffer
+    // can take a string longer than it has room for.
+    if (spec.width_ <= size)
+        buffer_.append(s, s + size);
+    else
+        write_str(s, size, spec);
 }
 
 template <typename Char>
 inline Arg pb::fmt::BasicFormatter<Char>::parse_arg_index(const Char *&s) {
     const char *error = 0;
-    Arg arg = *s < '0' || *s > '9' ?
-              next_arg(error) : get_arg(parse_nonnegative_int(s), error);
+    // '}' and ':' first: automatic indexing is by far the most common
+    Char c = *s;
+    bool is_index = '0' <= c && c <= '9';
+    Arg arg = c == '}' || c == ':' || !(is_index || is_name_start(c)) ?
+              next_arg(error) : is_index ?
+              get_arg(parse_nonnegative_int(s), error) :
+              get_named_arg(args(), parse_arg_name(s), error);
     if (error) {
         FMT_THROW(FormatError(
                       *s != '}' && *s != ':' ? "invalid format string" : error));
@@ -675,8 +1039,16 @@ inline Arg pb::fmt::BasicFormatter<Char>::parse_arg_index(const Char *&s) {
 FMT_FUNC Arg pb::fmt::internal::FormatterBase::do_get_arg(
     unsigned arg_index, const char *&error) {
     Arg arg = args_[arg_index];
-    if (arg.type == Arg::NONE)
+    switch (arg.type) {
+    case Arg::NONE:
         error = "argument index out of range";
+        break;
+    case Arg::NAMED_ARG:
+        arg = *static_cast<const Arg*>(arg.pointer);
+        break;
+    default:
+        break;
+    }
     return arg;
 }
 
@@ -942,6 +1314,291 @@ FMT_FUNC void pb::fmt::internal::PrintfFormatter<Char>::format(
     write(writer, start, s);
 }
 
+#if FMT_USE_PARSE_CACHE
+// A format string split into placeholders and escaped braces, each with the
+// literal text before it, and the literal text at the end. Most format
+// strings are literals, so the parse of one is kept in a table keyed by its
+// address: a later call with the same address only compares the string with
+// a copy of it and replays the parse. The table is lock free; entries are
+// published once and never change or go away.
+template <typename Char>
+struct pb::fmt::internal::ParsedFormat {
+    enum Kind { NO_ARG, NEXT_ARG, INDEXED_ARG, NAMED_ARG };
+
+    struct Segment {
+        // Literal text [literal, literal + literal_size) of the string.
+        unsigned literal;
+        unsigned literal_size;
+        Kind kind;
+        // The argument index. For a named argument it is the index the name
+        // had in the call which parsed the string, checked before use.
+        unsigned index;
+        unsigned name;
+        unsigned name_size;
+        // Offsets of the spec (at ':' or '}') and past the closing '}'.
+        unsigned spec;
+        unsigned end;
+        // Set if the spec needs no checks against the argument type, so
+        // that it could be parsed ahead of it into format_spec.
+        bool simple;
+        FormatSpec format_spec;
+    };
+
+    enum {
+        CACHE_SIZE = 1024, MAX_PROBES = 8,
+        MAX_SIZE = 512, MAX_SEGMENTS = 32, MAX_INDEX = 1000000
+    };
+
+    const Char *key;
+    std::size_t size;
+    // A copy of the string, as the address of a string which is not a
+    // literal can be reused for another one.
+    Char *text;
+    // 0 for a string left to the full parser.
+    unsigned segment_count;
+    Segment *segments;
+
+    ParsedFormat() : text(0), segment_count(0), segments(0) {}
+    ~ParsedFormat() {
+        delete [] text;
+        delete [] segments;
+    }
+
+    static std::atomic<const ParsedFormat*> cache[CACHE_SIZE];
+
+    // Returns the parse of format_str, parsing it if it is new, or null if
+    // it is to go through the full parser.
+    static const ParsedFormat *find(
+        BasicStringRef<Char> format_str, const ArgList &args);
+
+    // Parses format_str. Anything else than plain placeholders and escaped
+    // braces (nested arguments, errors) leaves the string to the full parser.
+    static FMT_NOINLINE ParsedFormat *parse(
+        BasicStringRef<Char> format_str, const ArgList &args);
+
+    // Parses a spec without the argument, when that can be done.
+    static bool parse_simple_spec(
+        const Char *s, const Char *end, FormatSpec &spec);
+};
+
+template <typename Char>
+std::atomic<const pb::fmt::internal::ParsedFormat<Char>*>
+    pb::fmt::internal::ParsedFormat<Char>::cache[CACHE_SIZE];
+
+template <typename Char>
+inline const pb::fmt::internal::ParsedFormat<Char> *
+    pb::fmt::internal::ParsedFormat<Char>::find(
+        BasicStringRef<Char> format_str, const ArgList &args) {
+    const Char *key = format_str.c_str();
+    std::size_t size = format_str.size();
+    if (size > MAX_SIZE)
+        return 0;
+    std::size_t hash = static_cast<std::size_t>(
+        (reinterpret_cast<uintptr_t>(key) >> 2) * 2654435761u);
+    for (unsigned i = 0; i < MAX_PROBES; ++i) {
+        std::atomic<const ParsedFormat*> &slot =
+            cache[(hash + i) & (CACHE_SIZE - 1)];
+        const ParsedFormat *parsed = slot.load(std::memory_order_acquire);
+        if (!parsed) {
+            ParsedFormat *fresh = parse(format_str, args);
+            if (slot.compare_exchange_strong(parsed, fresh,
+                                             std::memory_order_acq_rel)) {
+                return fresh->segment_count ? fresh : 0;
+            }
+            // Another thread took the slot, parsed is what it put there.
+            delete fresh;
+        }
+        if (parsed->key == key) {
+            return parsed->segment_count && parsed->size == size &&
+                std::char_traits<Char>::compare(parsed->text, key, size) == 0 ?
+                parsed : 0;
+        }
+    }
+    return 0;
+}
+
+template <typename Char>
+FMT_FUNC pb::fmt::internal::ParsedFormat<Char> *
+    pb::fmt::internal::ParsedFormat<Char>::parse(
+        BasicStringRef<Char> format_str, const ArgList &args) {
+    ParsedFormat *parsed = new ParsedFormat;
+    const Char *start = format_str.c_str();
+    parsed->key = start;
+    parsed->size = format_str.size();
+    parsed->text = new Char[parsed->size];
+    std::copy(start, start + parsed->size, parsed->text);
+    // The full parser reads a string up to its null whatever its size, so
+    // one with another length is left to it.
+    if (std::char_traits<Char>::length(start) != parsed->size)
+        return parsed;
+    Segment segments[MAX_SEGMENTS];
+    unsigned count = 0;
+    const Char *s = start, *literal = start, *end = start + parsed->size;
+    for (;;) {
+        s = find_brace(s, end);
+        if (count == MAX_SEGMENTS)
+            return parsed;
+        Segment &segment = segments[count++];
+        segment.literal = static_cast<unsigned>(literal - start);
+        segment.kind = NO_ARG;
+        Char c = s != end ? *s : Char();
+        if (!c) {
+            segment.literal_size = static_cast<unsigned>(s - literal);
+            break;
+        }
+        if (*++s == c) {
+            // An escaped brace, written as the end of the literal text.
+            segment.literal_size = static_cast<unsigned>(s - literal);
+            literal = ++s;
+            continue;
+        }
+        if (c == '}')
+            return parsed;
+        segment.literal_size = static_cast<unsigned>(s - 1 - literal);
+        c = *s;
+        if (c == '}' || c == ':') {
+            segment.kind = NEXT_ARG;
+        }
+        else if ('0' <= c && c <= '9') {
+            segment.kind = INDEXED_ARG;
+            unsigned index = 0;
+            do {
+                index = index * 10 + (*s - '0');
+                if (index > MAX_INDEX)
+                    return parsed;
+            } while ('0' <= *++s && *s <= '9');
+            segment.index = index;
+        }
+        else if (is_name_start(c)) {
+            segment.kind = NAMED_ARG;
+            segment.name = static_cast<unsigned>(s - start);
+            BasicStringRef<Char> name = parse_arg_name(s);
+            segment.name_size = static_cast<unsigned>(name.size());
+            segment.index = find_named_arg_index(args, name);
+        }
+        else {
+            return parsed;
+        }
+        segment.spec = static_cast<unsigned>(s - start);
+        segment.simple = true;
+        segment.format_spec = FormatSpec();
+        if (*s == ':') {
+            const Char *spec = ++s;
+            while (*s && *s != '}' && *s != '{')
+                ++s;
+            if (*s != '}')
+                return parsed;
+            segment.simple = parse_simple_spec(spec, s, segment.format_spec);
+        }
+        else if (*s != '}') {
+            return parsed;
+        }
+        literal = ++s;
+        segment.end = static_cast<unsigned>(s - start);
+    }
+    parsed->segments = new Segment[count];
+    std::copy(segments, segments + count, parsed->segments);
+    parsed->segment_count = count;
+    return parsed;
+}
+
+template <typename Char>
+FMT_FUNC bool pb::fmt::internal::ParsedFormat<Char>::parse_simple_spec(
+    const Char *s, const Char *end, FormatSpec &spec) {
+    // An empty spec is left to the full parser, which looks past it for
+    // an alignment.
+    if (s == end)
+        return false;
+    // Fill and alignment. '=' needs a numeric argument.
+    if (end - s >= 2 && (s[1] == '<' || s[1] == '>' || s[1] == '^')) {
+        spec.fill_ = *s;
+        s += 2;
+        spec.align_ = s[-1] == '<' ? ALIGN_LEFT :
+                      s[-1] == '>' ? ALIGN_RIGHT : ALIGN_CENTER;
+    }
+    else if (*s == '<' || *s == '>' || *s == '^') {
+        spec.align_ = *s == '<' ? ALIGN_LEFT :
+                      *s == '>' ? ALIGN_RIGHT : ALIGN_CENTER;
+        ++s;
+    }
+    else if (end - s >= 2 && s[1] == '=') {
+        return false;
+    }
+    // Sign, '#', zero padding and precision depend on the argument type.
+    if (s == end)
+        return true;
+    if (*s == '+' || *s == '-' || *s == ' ' || *s == '#' || *s == '0' ||
+        *s == '=' || *s == '.')
+        return false;
+    if ('1' <= *s && *s <= '9') {
+        unsigned width = 0;
+        do {
+            width = width * 10 + (*s - '0');
+            if (width > MAX_INDEX)
+                return false;
+        } while (++s != end && '0' <= *s && *s <= '9');
+        spec.width_ = width;
+    }
+    if (s == end)
+        return true;
+    // A precision after the width, which may be missing.
+    if (*s == '.')
+        return false;
+    spec.type_ = static_cast<char>(*s++);
+    return s == end;
+}
+
+template <typename Char>
+FMT_FUNC const Char *pb::fmt::BasicFormatter<Char>::format(
+    const internal::ParsedFormat<Char> &parsed, const Char *s) {
+    typedef internal::ParsedFormat<Char> ParsedFormat;
+    for (unsigned i = 0; i < parsed.segment_count; ++i) {
+        const typename ParsedFormat::Segment &segment = parsed.segments[i];
+        const Char *literal = s + segment.literal;
+        write(writer_, literal, literal + segment.literal_size);
+        const char *error = 0;
+        Arg arg;
+        switch (segment.kind) {
+        case ParsedFormat::NO_ARG:
+            continue;
+        case ParsedFormat::NEXT_ARG:
+            arg = next_arg(error);
+            break;
+        case ParsedFormat::INDEXED_ARG:
+            arg = get_arg(segment.index, error);
+            break;
+        case ParsedFormat::NAMED_ARG: {
+            BasicStringRef<Char> name(s + segment.name, segment.name_size);
+            if (segment.index != UINT_MAX) {
+                arg = args()[segment.index];
+                if (is_named_arg(arg, name)) {
+                    arg = *static_cast<const Arg*>(arg.pointer);
+                    break;
+                }
+            }
+            arg = get_named_arg(args(), name, error);
+            break;
+        }
+        }
+        if (error)
+            FMT_THROW(FormatError(error));
+        const Char *end = s + segment.end;
+        if (segment.simple && arg.type != Arg::CUSTOM) {
+            start_ = end;
+            FormatSpec spec = segment.format_spec;
+            internal::ArgFormatter<Char>(*this, spec, end - 1).visit(arg);
+        }
+        else {
+            const Char *spec = s + segment.spec;
+            const Char *next = format(spec, arg);
+            if (next != end)
+                return next;
+        }
+    }
+    return start_ = s + parsed.size;
+}
+#endif
+
 template <typename Char>
 FMT_FUNC const Char *pb::fmt::BasicFormatter<Char>::format(
     const Char *&format_str, const Arg &arg) {
@@ -1087,9 +1744,26 @@ FMT_FUNC void pb::fmt::BasicFormatter<Char>::format(
     BasicStringRef<Char> format_str, const ArgList &args) {
     const Char *s = start_ = format_str.c_str();
     set_args(args);
-    while (*s) {
+    const Char *end = s + format_str.size();
+#if FMT_USE_PARSE_CACHE
+    if (const internal::ParsedFormat<Char> *parsed =
+            internal::ParsedFormat<Char>::find(format_str, args))
+        s = format(*parsed, s);
+#endif
+    for (;;) {
+        // A placeholder or an escaped brace may cross the size.
+        if (s > end)
+            end = s;
+        s = find_brace(s, end);
+        if (!*s)
+            break;
+        if (s == end) {
+            // The string goes on past its size. It is read up to the null,
+            // as placeholders are.
+            end = s + std::char_traits<Char>::length(s);
+            continue;
+        }
         Char c = *s++;
-        if (c != '{' && c != '}') continue;
         if (*s == c) {
             write(writer_, start_, s);
             start_ = ++s;
@@ -60,6 +60,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cstdio>
 #include <algorithm>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <sstream>
@@ -126,6 +127,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 # include <utility>  // for std::move
 #endif
 
+#ifndef FMT_USE_PARSE_CACHE
+// Keep the parsed form of each format string for the next call with the
+// same string, see ParsedFormat in format.cc. Needs C++11 atomics.
+# define FMT_USE_PARSE_CACHE (__cplusplus >= 201103 || _MSC_VER >= 1700)
+#endif
+
+#if FMT_USE_PARSE_CACHE
+# include <atomic>
+#endif
+
 // Define FMT_USE_NOEXCEPT to make C++ Format use noexcept (C++11 feature).
 #if FMT_USE_NOEXCEPT || FMT_HAS_FEATURE(cxx_noexcept) || \
 (FMT_GCC_VERSION >= 408 && __cplusplus >= 201103)
@@ -134,6 +145,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 # define FMT_NOEXCEPT(expr)
 #endif
 
+// Keeps a rarely taken path out of the formatting loop it is called from.
+#if defined(__GNUC__) || defined(__clang__)
+# define FMT_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+# define FMT_NOINLINE __declspec(noinline)
+#else
+# define FMT_NOINLINE
+#endif
+
 // A macro to disallow the copy constructor and operator= functions
 // This should be used in the private: declarations for a class
 #define FMT_DISALLOW_COPY_AND_ASSIGN(TypeName) \
@@ -270,6 +290,10 @@ namespace internal
 // to avoid dynamic memory allocation.
     enum { INLINE_BUFFER_SIZE = 500 };
 
+// Throws FormatError for a piece of output longer than a buffer which
+// can't grow (see FixedBuffer) has room for.
+void report_buffer_overflow();
+
 #if _SECURE_SCL
 // Use checked iterator to avoid warnings on MSVC.
 template <typename T>
@@ -302,6 +326,25 @@ template <typename T>
 
         virtual void grow(std::size_t size) = 0;
 
+        // Makes room for num_elements more elements in one piece when grow
+        // has left less. Only a buffer which can't grow as asked needs it.
+        virtual void grow_piece(std::size_t)
+        {
+            report_buffer_overflow();
+        }
+
+    private:
+        // Grows the buffer for resize and reserve and returns the new size.
+        // grow may move the content to a new size_ (see FixedBuffer).
+        FMT_NOINLINE std::size_t grow_for_resize(std::size_t new_size)
+        {
+            std::size_t num_elements = new_size - size_;
+            grow(new_size);
+            if (size_ + num_elements > capacity_)
+                grow_piece(num_elements);
+            return size_ + num_elements;
+        }
+
     public:
         virtual ~Buffer() {}
 
@@ -321,7 +364,7 @@ template <typename T>
         void resize(std::size_t new_size)
         {
             if (new_size > capacity_)
-                grow(new_size);
+                new_size = grow_for_resize(new_size);
             size_ = new_size;
         }
 
@@ -329,7 +372,7 @@ template <typename T>
         void reserve(std::size_t capacity)
         {
             if (capacity > capacity_)
-                grow(capacity);
+                grow_for_resize(capacity);
         }
 
         void clear() FMT_NOEXCEPT(true)
@@ -345,7 +388,8 @@ template <typename T>
         }
 
     // Appends data to the end of the buffer.
-        void append(const T *begin, const T *end);
+    template <typename U>
+        void append(const U *begin, const U *end);
 
         T &operator[](std::size_t index)
         {
@@ -358,11 +402,24 @@ template <typename T>
     };
 
 template <typename T>
-    void Buffer<T>::append(const T *begin, const T *end)
+template <typename U>
+    void Buffer<T>::append(const U *begin, const U *end)
     {
-        std::ptrdiff_t num_elements = end - begin;
+        std::size_t num_elements = end - begin;
         if (size_ + num_elements > capacity_)
+        {
             grow(size_ + num_elements);
+            // A buffer which can't grow as asked takes the data in pieces.
+            while (size_ + num_elements > capacity_)
+            {
+                std::size_t n = capacity_ - size_;
+                std::copy(begin, begin + n, make_ptr(ptr_, capacity_) + size_);
+                size_ += n;
+                begin += n;
+                num_elements -= n;
+                grow(size_ + num_elements);
+            }
+        }
         std::copy(begin, end, make_ptr(ptr_, capacity_) + size_);
         size_ += num_elements;
     }
@@ -458,6 +515,94 @@ template <typename T, std::size_t SIZE, typename Allocator>
             this->deallocate(old_ptr, old_capacity);
     }
 
+// A buffer over a fixed array. What doesn't fit in
+// the array is dropped, but counted. Output past the end goes to a spill
+// area in the object first, which is moved to the rest of the array when it
+// fills up and on flush, so the array ends up with exactly the first
+// characters of the output. A single piece of output which doesn't fit and
+// is longer than the spill area (a field padded to hundreds of characters)
+// goes to a larger area allocated for it, the only case which allocates.
+// Unlike MemoryBuffer, growing changes the indices of the spilled content;
+// the content is in the array, and size() counts it, after flush.
+template <typename T>
+    class FixedBuffer : public Buffer<T>
+    {
+    private:
+        T *array_;
+        std::size_t array_size_;
+        // The number of characters in the array while spilling.
+        std::size_t kept_;
+        std::size_t dropped_;
+        T spill_[INLINE_BUFFER_SIZE];
+        // The area for pieces longer than spill_, kept for reuse.
+        std::unique_ptr<T[]> piece_;
+        std::size_t piece_size_;
+
+        // Moves the spilled characters to the array as far as they fit.
+        void unspill()
+        {
+            std::size_t n = (std::min)(this->size_, array_size_ - kept_);
+            std::copy(this->ptr_, this->ptr_ + n,
+              make_ptr(array_, array_size_) + kept_);
+            kept_ += n;
+            dropped_ += this->size_ - n;
+        }
+
+    protected:
+        void grow(std::size_t)
+        {
+            if (this->ptr_ == array_)
+                kept_ = this->size_;
+            else
+                unspill();
+            this->ptr_ = spill_;
+            this->size_ = 0;
+            this->capacity_ = INLINE_BUFFER_SIZE;
+        }
+
+        // Called after grow, so the content has just been moved to the array.
+        void grow_piece(std::size_t num_elements)
+        {
+            if (piece_size_ < num_elements)
+            {
+                piece_size_ = (std::max)(num_elements, 2 * piece_size_);
+                piece_.reset(new T[piece_size_]);
+            }
+            this->ptr_ = piece_.get();
+            this->capacity_ = piece_size_;
+        }
+
+    public:
+        FixedBuffer(T *array, std::size_t size)
+        : Buffer<T>(array, size), array_(array), array_size_(size),
+          kept_(0), dropped_(0), piece_size_(0) {}
+
+        // Moves the content to the array.
+        void flush()
+        {
+            if (this->ptr_ == array_)
+                return;
+            unspill();
+            this->ptr_ = array_;
+            this->size_ = kept_;
+            this->capacity_ = array_size_;
+        }
+
+        // Returns the size of the output, including what was dropped.
+        std::size_t full_size() const
+        {
+            return (this->ptr_ == array_ ? 0 : kept_) + this->size_ + dropped_;
+        }
+
+        void reset()
+        {
+            this->ptr_ = array_;
+            this->size_ = 0;
+            this->capacity_ = array_size_;
+            kept_ = dropped_ = 0;
+        }
+    };
+
 #ifndef _MSC_VER
 // Portable version of signbit.
     inline int getsign(double x)
@@ -645,6 +790,16 @@ FMT_SPECIALIZE_MAKE_UNSIGNED(LongLong, ULongLong);
 
 void report_unknown_type(char code, const char *type);
 
+enum { NATIVE_FLOAT_BUFFER_SIZE = 128 };
+
+// Formats a finite, non-negative double like printf's "%.*e", "%.*f" or
+// "%.*g" (type is one of eEfFgG, precision < 0 means 6), digit for digit,
+// using exact integer arithmetic instead of snprintf. buffer must hold
+// NATIVE_FLOAT_BUFFER_SIZE characters. Returns the number of characters
+// written, or -1 if the value or precision is outside the handled range
+// (or there is no 128-bit integer type); the caller then uses snprintf.
+int format_float_native(char *buffer, double value, char type, int precision);
+
 // Static data is placed in this class template to allow header-only
 // configuration.
 template <typename T = void>
@@ -851,11 +1006,17 @@ struct Arg : Value
         INT, UINT, LONG_LONG, ULONG_LONG, CHAR, LAST_INTEGER_TYPE = CHAR,
         // followed by floating-point types.
         DOUBLE, LONG_DOUBLE, LAST_NUMERIC_TYPE = LONG_DOUBLE,
-        CSTRING, STRING, WSTRING, POINTER, CUSTOM
+        CSTRING, STRING, WSTRING, POINTER, CUSTOM,
+        // A named argument. pointer is the Arg it wraps; FormatterBase hands
+        // out the wrapped Arg, so visitors never see this type.
+        NAMED_ARG
     };
     Type type;
 };
 
+template <typename Char>
+struct NamedArg;
+
 // Makes a Value object from any type.
 template <typename Char>
 class MakeValue : public Value
@@ -971,6 +1132,16 @@ public:
     FMT_MAKE_VALUE(void *, pointer, POINTER)
     FMT_MAKE_VALUE(const void *, pointer, POINTER)
 
+    MakeValue(const NamedArg<Char> &value)
+    {
+        pointer = static_cast<const Arg*>(&value);
+    }
+    template <typename Char_>
+    static uint64_t type(const NamedArg<Char_> &)
+    {
+        return Arg::NAMED_ARG;
+    }
+
     template <typename T>
     MakeValue(const T &value)
     {
@@ -982,6 +1153,35 @@ public:
     {
         return Arg::CUSTOM;
     }
+
+private:
+    // A named argument of the other character type. Do not implement!
+    template <typename Char_>
+    MakeValue(const NamedArg<Char_> &value);
+};
+
+// Makes an Arg object, a value together with its type, from any type.
+template <typename Char>
+class MakeArg : public Arg
+{
+public:
+    template <typename T>
+    MakeArg(const T &value)
+    {
+        Value &v = *this;
+        v = MakeValue<Char>(value);
+        type = static_cast<Arg::Type>(MakeValue<Char>::type(value));
+    }
+};
+
+template <typename Char>
+struct NamedArg : Arg
+{
+    BasicStringRef<Char> name;
+
+    template <typename T>
+    NamedArg(BasicStringRef<Char> argname, const T &value)
+    : Arg(MakeArg<Char>(value)), name(argname) {}
 };
 
 #define FMT_DISPATCH(call) static_cast<Impl*>(this)->call
@@ -1123,6 +1323,12 @@ class ArgFormatter;
 
 /**
 An argument list.
+
+The types of the first MAX_PACKED_ARGS arguments are packed 4 bits each in
+one integer. A list that fills all of them may be longer; it has an
+extended type descriptor, the types of all its arguments one byte each
+terminated by NONE, pointed to by the value before the first argument.
+Short lists, the common case, never look at it.
 */
 class ArgList
 {
@@ -1130,9 +1336,25 @@ private:
     uint64_t types_;
     const internal::Value *values_;
 
+    // The type of an argument past the packed ones.
+    internal::Arg::Type ext_type(unsigned index) const
+    {
+        using internal::Arg;
+        if ((types_ >> (4 * (MAX_PACKED_ARGS - 1))) == Arg::NONE)
+            return Arg::NONE;
+        const unsigned char *types =
+            static_cast<const unsigned char*>(values_[-1].pointer);
+        for (unsigned i = MAX_PACKED_ARGS; i < index; ++i)
+        {
+            if (types[i] == Arg::NONE)
+                return Arg::NONE;
+        }
+        return static_cast<Arg::Type>(types[index]);
+    }
+
 public:
-    // Maximum number of arguments that can be passed in ArgList.
-    enum { MAX_ARGS = 16 };
+    // Maximum number of arguments with packed types.
+    enum { MAX_PACKED_ARGS = 16 };
 
     ArgList() : types_(0) {}
     ArgList(ULongLong types, const internal::Value *values)
@@ -1145,9 +1367,14 @@ public:
     {
         using internal::Arg;
         Arg arg;
-        if (index >= MAX_ARGS)
+        if (index >= MAX_PACKED_ARGS)
         {
-            arg.type = Arg::NONE;
+            arg.type = ext_type(index);
+            if (arg.type != Arg::NONE)
+            {
+                internal::Value &value = arg;
+                value = values_[index];
+            }
             return arg;
         }
         unsigned shift = index * 4;
@@ -1169,6 +1396,11 @@ struct FormatSpec;
 namespace internal
 {
 
+#if FMT_USE_PARSE_CACHE
+    template <typename Char>
+    struct ParsedFormat;
+#endif
+
     class FormatterBase
     {
     private:
@@ -1192,6 +1424,11 @@ namespace internal
     // specified index.
         Arg get_arg(unsigned arg_index, const char *&error);
 
+        const ArgList &args() const
+        {
+            return args_;
+        }
+
     template <typename Char>
         void write(BasicWriter<Char> &w, const Char *start, const Char *end)
         {
@@ -1228,10 +1465,16 @@ class BasicFormatter : private internal::FormatterBase
 private:
     BasicWriter<Char> &writer_;
     const Char *start_;
-
-    // Parses argument index and returns corresponding argument.
+    // Parses argument index or name and returns corresponding argument.
     internal::Arg parse_arg_index(const Char *&s);
 
+#if FMT_USE_PARSE_CACHE
+    // Formats the string s from its cached parse and returns where the
+    // scan of s is to go on: its end, unless a custom argument took another
+    // part of the string than the parse expected.
+    const Char *format(const internal::ParsedFormat<Char> &parsed, const Char *s);
+#endif
+
 public:
     explicit BasicFormatter(BasicWriter<Char> &w) : writer_(w) {}
 
@@ -1525,6 +1768,29 @@ inline StrFormatSpec<wchar_t> pad(
     return StrFormatSpec<wchar_t>(str, width, fill);
 }
 
+/**
+\rst
+Returns a named argument for the formatting functions, referred to as
+``{name}`` in the format string. A named argument is also a positional one.
+
+**Example**::
+
+print("Elapsed time: {s:.2f} seconds", arg("s", 1.23));
+
+\endrst
+*/
+template <typename T>
+inline internal::NamedArg<char> arg(StringRef name, const T &value)
+{
+    return internal::NamedArg<char>(name, value);
+}
+
+template <typename T>
+inline internal::NamedArg<wchar_t> arg(WStringRef name, const T &value)
+{
+    return internal::NamedArg<wchar_t>(name, value);
+}
+
 // Generates a comma-separated list with results of applying f to
 // numbers 0..n-1.
 # define FMT_GEN(n, f) FMT_GEN##n(f)
@@ -1558,11 +1824,61 @@ template <typename T>
     }
 
 #if FMT_USE_VARIADIC_TEMPLATES
+// Types past the 16th are shifted out, leaving the packed types of the
+// first ArgList::MAX_PACKED_ARGS arguments.
 template <typename Arg, typename... Args>
     inline uint64_t make_type(const Arg &first, const Args & ... tail)
     {
         return make_type(first) | (make_type(tail...) << 4);
     }
+
+template <typename T>
+    inline unsigned char ext_type(const T &arg)
+    {
+        return static_cast<unsigned char>(MakeValue<char>::type(arg));
+    }
+
+// The values a variadic function passes N arguments in. A list of
+// ArgList::MAX_PACKED_ARGS or more starts with a value pointing to its
+// extended type descriptor; a shorter one ignores the descriptor, and
+// compilers drop the stores that built it.
+template <typename Char, unsigned N,
+          bool LONG = (N >= ArgList::MAX_PACKED_ARGS)>
+    struct ArgArray
+    {
+        Value values[NonZero<N>::VALUE];
+
+    template <typename... Args>
+        ArgArray(const unsigned char *, const Args & ... args)
+        : values{MakeValue<Char>(args)...} {}
+
+        const Value *data() const
+        {
+            return values;
+        }
+    };
+
+template <typename Char, unsigned N>
+    struct ArgArray<Char, N, true>
+    {
+        Value values[N + 1];
+
+        static Value make_ext_types(const unsigned char *types)
+        {
+            Value value;
+            value.pointer = types;
+            return value;
+        }
+
+    template <typename... Args>
+        ArgArray(const unsigned char *types, const Args & ... args)
+        : values{make_ext_types(types), MakeValue<Char>(args)...} {}
+
+        const Value *data() const
+        {
+            return values + 1;
+        }
+    };
 #else
 
     struct ArgType
@@ -1598,23 +1914,21 @@ template <typename Arg, typename... Args>
 # define FMT_VARIADIC_VOID(func, arg_type) \
   template <typename... Args> \
 void func(arg_type arg1, const Args & ... args) { \
-    const fmt::internal::Value values[ \
-      fmt::internal::NonZero<sizeof...(Args)>::VALUE] = { \
-      fmt::internal::MakeValue<Char>(args)... \
-  }; \
-  func(arg1, ArgList(fmt::internal::make_type(args...), values)); \
+    const unsigned char types[] = {fmt::internal::ext_type(args)..., 0}; \
+    const fmt::internal::ArgArray<Char, sizeof...(Args)> values( \
+      types, args...); \
+  func(arg1, ArgList(fmt::internal::make_type(args...), values.data())); \
 }
 
 // Defines a variadic constructor.
 # define FMT_VARIADIC_CTOR(ctor, func, arg0_type, arg1_type) \
   template <typename... Args> \
 ctor(arg0_type arg0, arg1_type arg1, const Args & ... args) { \
-    using fmt::internal::MakeValue; \
-    const fmt::internal::Value values[ \
-        fmt::internal::NonZero<sizeof...(Args)>::VALUE] = { \
-      MakeValue<Char>(args)... \
-  }; \
-  func(arg0, arg1, ArgList(fmt::internal::make_type(args...), values)); \
+    const unsigned char types[] = {fmt::internal::ext_type(args)..., 0}; \
+    const fmt::internal::ArgArray<Char, sizeof...(Args)> values( \
+      types, args...); \
+  func(arg0, arg1, \
+      ArgList(fmt::internal::make_type(args...), values.data())); \
 }
 
 #else
@@ -1773,9 +2087,8 @@ private:
     // allocated area.
     CharPtr grow_buffer(std::size_t n)
     {
-        std::size_t size = buffer_.size();
-        buffer_.resize(size + n);
-        return internal::make_ptr(&buffer_[size], n);
+        buffer_.resize(buffer_.size() + n);
+        return internal::make_ptr(&buffer_[buffer_.size() - n], n);
     }
 
     // Prepare a buffer for integer formatting.
@@ -1989,6 +2302,14 @@ public:
     {
         buffer_.clear();
     }
+
+    /**
+    Returns the output buffer, for writing into its storage directly.
+    */
+    internal::Buffer<Char> &buffer() FMT_NOEXCEPT(true)
+    {
+        return buffer_;
+    }
 };
 
 template <typename Char>
@@ -2305,15 +2626,33 @@ void BasicWriter<Char>::write_double(
         return;
     }
 
-    std::size_t offset = buffer_.size();
+    // Without padding, let alone '#', the common cases ({}, {:.2f}) are
+    // formatted natively. The result is the same as snprintf's.
+    if (!internal::IsLongDouble<T>::VALUE && type != 'a' && type != 'A' &&
+        spec.width() == 0 && !spec.flag(HASH_FLAG))
+    {
+        char digits[internal::NATIVE_FLOAT_BUFFER_SIZE];
+        int n = internal::format_float_native(
+            digits, static_cast<double>(value), type, spec.precision());
+        if (n >= 0)
+        {
+            CharPtr out = grow_buffer(n + (sign ? 1 : 0));
+            if (sign)
+                *out++ = sign;
+            std::copy(digits, digits + n, out);
+            return;
+        }
+    }
+
     unsigned width = spec.width();
     if (sign)
     {
         buffer_.reserve(buffer_.size() + (std::max)(width, 1u));
         if (width > 0)
             --width;
-        ++offset;
     }
+    // Taken after reserve: a FixedBuffer moves its content when growing.
+    std::size_t offset = buffer_.size() + (sign ? 1 : 0);
 
     // Build format string.
     enum { MAX_FORMAT_SIZE = 10 }; // longest format: %#-*.*Lg
@@ -2356,6 +2695,7 @@ void BasicWriter<Char>::write_double(
         if (size == 0)
         {
             buffer_.reserve(offset + 1);
+            offset = buffer_.size() + (sign ? 1 : 0);
             size = buffer_.capacity() - offset;
         }
 #endif
@@ -2400,6 +2740,9 @@ void BasicWriter<Char>::write_double(
         // If n is negative we ask to increase the capacity by at least 1,
         // but as std::vector, the buffer grows exponentially.
         buffer_.reserve(n >= 0 ? offset + n + 1 : buffer_.capacity() + 1);
+        offset = buffer_.size() + (sign ? 1 : 0);
+        if (buffer_.capacity() - offset <= size)
+            internal::report_buffer_overflow();
     }
 }
 
@@ -2466,11 +2809,138 @@ public:
         return *this;
     }
 #endif
+
+    /**
+    Returns the number of characters the writer can hold without growing.
+    */
+    std::size_t capacity() const
+    {
+        return buffer_.capacity();
+    }
 };
 
 typedef BasicMemoryWriter<char> MemoryWriter;
 typedef BasicMemoryWriter<wchar_t> WMemoryWriter;
 
+/**
+\rst
+This template provides operations for formatting and writing data into
+a fixed-size array of characters. Output which doesn't fit is dropped, and
+:meth:`full_size` tells how long the whole output would have been. It
+allocates only for a single field longer than 500 characters which crosses
+the end of the array.
+
+The content is read with the methods of this class, which hide the ones of
+``BasicWriter``; no terminating null character is appended, except by
+:meth:`c_str`.
+
+You can use one of the following typedefs for common character types:
+
++--------------+-----------------------------+
+| Type         | Definition                  |
++==============+=============================+
+| FixedWriter  | BasicFixedWriter<char>      |
++--------------+-----------------------------+
+| WFixedWriter | BasicFixedWriter<wchar_t>   |
++--------------+-----------------------------+
+
+**Example**::
+
+char record[32];
+FixedWriter out(record);
+out.write("user={} action={}", user, action);
+if (out.truncated())
+  ...
+
+\endrst
+*/
+template <typename Char>
+class BasicFixedWriter : public BasicWriter<Char>
+{
+private:
+    mutable internal::FixedBuffer<Char> buffer_;
+
+public:
+    /**
+    Constructs a ``BasicFixedWriter`` object writing to the array of *size*
+    characters at *array*.
+    */
+    BasicFixedWriter(Char *array, std::size_t size)
+    : BasicWriter<Char>(buffer_), buffer_(array, size) {}
+
+    template <std::size_t SIZE>
+    explicit BasicFixedWriter(Char (&array)[SIZE])
+    : BasicWriter<Char>(buffer_), buffer_(array, SIZE) {}
+
+    /**
+    Returns the number of characters in the array.
+    */
+    std::size_t size() const
+    {
+        buffer_.flush();
+        return buffer_.size();
+    }
+
+    /**
+    Returns a pointer to the array.
+    */
+    const Char *data() const
+    {
+        buffer_.flush();
+        return &buffer_[0];
+    }
+
+    /**
+    Returns a pointer to the array with a terminating null character
+    appended. If the array is full the null character replaces its last
+    character.
+    */
+    const Char *c_str() const
+    {
+        buffer_.flush();
+        std::size_t size = buffer_.size();
+        if (size == buffer_.capacity())
+        {
+            static const Char EMPTY[1] = {0};
+            if (size == 0)
+                return EMPTY;
+            --size;
+        }
+        buffer_[size] = '\0';
+        return &buffer_[0];
+    }
+
+    std::basic_string<Char> str() const
+    {
+        return std::basic_string<Char>(data(), size());
+    }
+
+    /**
+    Returns the size of the output, including what didn't fit in the array.
+    */
+    std::size_t full_size() const
+    {
+        buffer_.flush();
+        return buffer_.full_size();
+    }
+
+    /**
+    Returns true if output was dropped.
+    */
+    bool truncated() const
+    {
+        return full_size() > size();
+    }
+
+    void clear() FMT_NOEXCEPT(true)
+    {
+        buffer_.reset();
+    }
+};
+
+typedef BasicFixedWriter<char> FixedWriter;
+typedef BasicFixedWriter<wchar_t> WFixedWriter;
+
 // Formats a value.
 template <typename Char, typename T>
 void format(BasicFormatter<Char> &f, const Char *&format_str, const T &value)
@@ -2555,6 +3025,34 @@ inline std::wstring format(WStringRef format_str, ArgList args)
     return w.str();
 }
 
+/**
+\rst
+Formats arguments to the array of *size* characters at *out* without a
+terminating null character, and returns the size of the whole output,
+which is longer than *size* if it was truncated.
+
+**Example**::
+
+char field[16];
+std::size_t n = format_to_n(field, sizeof(field), "{}:{}", host, port);
+\endrst
+*/
+inline std::size_t format_to_n(
+    char *out, std::size_t size, StringRef format_str, ArgList args)
+{
+    FixedWriter w(out, size);
+    w.write(format_str, args);
+    return w.full_size();
+}
+
+inline std::size_t format_to_n(
+    wchar_t *out, std::size_t size, WStringRef format_str, ArgList args)
+{
+    WFixedWriter w(out, size);
+    w.write(format_str, args);
+    return w.full_size();
+}
+
 /**
 \rst
 Prints formatted data to the file *f*.
@@ -2799,12 +3297,11 @@ FMT_EXPAND(FMT_FOR_EACH_(FMT_NARG(__VA_ARGS__), f, __VA_ARGS__))
   template <typename... Args> \
 ReturnType func(FMT_FOR_EACH(FMT_ADD_ARG_NAME, __VA_ARGS__), \
   const Args & ... args) { \
-    using fmt::internal::Value; \
-    const Value values[fmt::internal::NonZero<sizeof...(Args)>::VALUE] = { \
-      fmt::internal::MakeValue<Char>(args)... \
-  }; \
+    const unsigned char types[] = {fmt::internal::ext_type(args)..., 0}; \
+    const fmt::internal::ArgArray<Char, sizeof...(Args)> values( \
+      types, args...); \
   call(FMT_FOR_EACH(FMT_GET_ARG_NAME, __VA_ARGS__), fmt::ArgList( \
-      fmt::internal::make_type(args...), values)); \
+      fmt::internal::make_type(args...), values.data())); \
 }
 #else
 // Defines a wrapper for a function taking __VA_ARGS__ arguments
@@ -2878,6 +3375,9 @@ namespace pb
     {
         FMT_VARIADIC(std::string, format, StringRef)
         FMT_VARIADIC_W(std::wstring, format, WStringRef)
+        FMT_VARIADIC(std::size_t, format_to_n, char *, std::size_t, StringRef)
+        FMT_VARIADIC_W(std::size_t, format_to_n, wchar_t *, std::size_t,
+                       WStringRef)
         FMT_VARIADIC(void, print, StringRef)
         FMT_VARIADIC(void, print, std::FILE *, StringRef)
         FMT_VARIADIC(void, print, std::ostream &, StringRef)
@@ -0,0 +1,244 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-29 09:40:27
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-29 15:22:08
+*/
+
+#ifndef PB_UTIL_HEX_H_
+#define PB_UTIL_HEX_H_
+
+// Hex formatting of byte buffers.
+//
+// ByteSpan is a format argument:
+//
+// {} or {:x}  lowercase hex digits, 2 per byte: 48656c6c6f
+// {:X}        uppercase hex digits
+// {:h}        a hexdump, 16 bytes per line with offset, hex and ASCII:
+//             00000000  48 65 6c 6c 6f 20 77 6f  72 6c 64 0a  |Hello world.|
+//
+// A precision caps the number of bytes shown, "..." marks the cut:
+// {:.64x}, {:.256h}. Lines of a hexdump are separated by '\n', without one
+// after the last.
+//
+// Example:
+//
+// logger->debug("recv {} bytes: {:.32x}", n, pb::ByteSpan(buf, n));
+// logger->trace() << pb::ByteSpan(buf, n);
+//
+// Digits are made 16 bytes at a time with SSE2 where available.
+
+#include <cstddef>
+#include <common/util/format.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PB_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace pb
+{
+struct ByteSpan
+{
+    ByteSpan(const void* p, std::size_t n) :
+        data(static_cast<const unsigned char*>(p)), size(n) {}
+
+    const unsigned char* data;
+    std::size_t size;
+};
+
+// write the 2 * size hex digits of s to out
+inline void HexEncode(const unsigned char* s, std::size_t size, char* out,
+                      bool upper = false)
+{
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    std::size_t i = 0;
+#ifdef PB_HAVE_SSE2
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    // from '0' + 10 to 'a' or 'A'
+    const __m128i letter = _mm_set1_epi8(upper ? 'A' - '0' - 10 : 'a' - '0' - 10);
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low_mask);
+        __m128i lo = _mm_and_si128(v, low_mask);
+        __m128i first = _mm_unpacklo_epi8(hi, lo);
+        __m128i second = _mm_unpackhi_epi8(hi, lo);
+        first = _mm_add_epi8(_mm_add_epi8(first, zero),
+            _mm_and_si128(_mm_cmpgt_epi8(first, nine), letter));
+        second = _mm_add_epi8(_mm_add_epi8(second, zero),
+            _mm_and_si128(_mm_cmpgt_epi8(second, nine), letter));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), first);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 16), second);
+    }
+#endif
+    for (; i < size; ++i)
+    {
+        out[2 * i] = digits[s[i] >> 4];
+        out[2 * i + 1] = digits[s[i] & 0xF];
+    }
+}
+
+namespace details
+{
+// bytes encoded per step, so that a writer over a fixed array (which takes
+// bounded pieces) can hold any span
+static const std::size_t kHexChunk = 128;
+
+// room for n characters at the end of w
+inline char* HexGrow(fmt::Writer& w, std::size_t n)
+{
+    fmt::internal::Buffer<char>& buffer = w.buffer();
+    buffer.resize(buffer.size() + n);
+    return &buffer[buffer.size() - n];
+}
+
+inline void WriteHex(fmt::Writer& w, const unsigned char* s, std::size_t size,
+                     bool upper)
+{
+    while (size)
+    {
+        std::size_t n = size < kHexChunk ? size : kHexChunk;
+        HexEncode(s, n, HexGrow(w, 2 * n), upper);
+        s += n;
+        size -= n;
+    }
+}
+
+// one line of the hexdump: the offset, 16 bytes (or less on the last line)
+// in hex, with an extra space after the 8th, and as ASCII
+inline void WriteHexdumpLine(fmt::Writer& w, std::size_t offset,
+                             const unsigned char* s, std::size_t n)
+{
+    // "00000000  " + 16 * "xx " + " " + " |" + 16 chars + "|"
+    static const std::size_t kLineSize = 10 + 48 + 1 + 2 + 16 + 1;
+    char hex[32];
+    HexEncode(s, n, hex);
+    char* out = HexGrow(w, kLineSize - (16 - n));
+    for (int shift = 28; shift >= 0; shift -= 4)
+    {
+        *out++ = "0123456789abcdef"[(offset >> shift) & 0xF];
+    }
+    *out++ = ' ';
+    for (std::size_t i = 0; i < 16; ++i)
+    {
+        if (i == 8)
+        {
+            *out++ = ' ';
+        }
+        *out++ = ' ';
+        if (i < n)
+        {
+            *out++ = hex[2 * i];
+            *out++ = hex[2 * i + 1];
+        }
+        else
+        {
+            *out++ = ' ';
+            *out++ = ' ';
+        }
+    }
+    *out++ = ' ';
+    *out++ = ' ';
+    *out++ = '|';
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        *out++ = s[i] >= 0x20 && s[i] < 0x7F ? static_cast<char>(s[i]) : '.';
+    }
+    *out = '|';
+}
+
+inline void WriteHexdump(fmt::Writer& w, const unsigned char* s,
+                         std::size_t size)
+{
+    for (std::size_t offset = 0; offset < size; offset += 16)
+    {
+        if (offset)
+        {
+            w << '\n';
+        }
+        std::size_t n = size - offset < 16 ? size - offset : 16;
+        WriteHexdumpLine(w, offset, s + offset, n);
+    }
+}
+} // ns details
+
+// formats a ByteSpan argument, see the top of this file
+inline void format(fmt::BasicFormatter<char>& f, const char*& format_str,
+                   const ByteSpan& span)
+{
+    const char* s = format_str;
+    std::size_t size = span.size;
+    bool cut = false;
+    char type = 'x';
+    if (*s == ':')
+    {
+        ++s;
+        if (*s == '.')
+        {
+            std::size_t max_size = 0;
+            const char* digits = ++s;
+            for (; '0' <= *s && *s <= '9'; ++s)
+            {
+                max_size = max_size * 10 + (*s - '0');
+            }
+            if (s == digits)
+            {
+                throw fmt::FormatError("missing precision specifier");
+            }
+            if (max_size < size)
+            {
+                size = max_size;
+                cut = true;
+            }
+        }
+        if (*s == 'x' || *s == 'X' || *s == 'h')
+        {
+            type = *s++;
+        }
+    }
+    if (*s != '}')
+    {
+        throw fmt::FormatError("invalid format specifier for bytes");
+    }
+    fmt::Writer& w = f.writer();
+    if (type == 'h')
+    {
+        details::WriteHexdump(w, span.data, size);
+        if (cut)
+        {
+            w << fmt::StringRef("\n...", 4);
+        }
+    }
+    else
+    {
+        details::WriteHex(w, span.data, size, type == 'X');
+        if (cut)
+        {
+            w << fmt::StringRef("...", 3);
+        }
+    }
+    // an empty argument for the closing brace, so the formatter moves past
+    // the whole placeholder
+    format_str = f.format(s, fmt::internal::MakeArg<char>(fmt::StringRef("", 0)));
+}
+} // ns pb
+
+#endif // PB_UTIL_HEX_H_
@@ -32,9 +32,22 @@
 #  define WIN32_LEAN_AND_MEAN
 # endif
 #include <Windows.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
 #endif
 
+#include <thread>
+#include <functional>
+
 #include <common/log/common_def.h>
+#include <common/util/timezone.h>
 
 namespace pb
 {
@@ -52,6 +65,17 @@ inline pb::log_clock::time_point now()
     return log_clock::now();
 }
 
+inline std::tm localtime(const std::time_t &time_tt)
+{
+    std::tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &time_tt);
+#else
+    localtime_r(&time_tt, &tm);
+#endif
+    return tm;
+}
+
 inline std::tm localtime()
 {
     std::time_t now_t = time(nullptr);
@@ -95,7 +119,7 @@ inline bool operator!=(const std::tm& tm1, const std::tm& tm2)
 inline const char *eol() { return "\r\n"; }
 inline unsigned short eol_size() { return 2; }
 #else
-constexpr inline const char* eol() { return "\r\n"; }
+constexpr inline const char* eol() { return "\n"; }
 constexpr inline unsigned short eol_size() { return 1; }
 #endif
 
@@ -111,8 +135,72 @@ inline int fopen_s(FILE** fp, const std::string& filename, const char* mode)
 #endif
 }
 
+// id of the calling thread as shown by the os tools (the tid on linux).
+// cached per thread, the syscall is done once
+inline std::size_t thread_id()
+{
+#ifdef _WIN32
+    return static_cast<std::size_t>(::GetCurrentThreadId());
+#elif defined(__linux__)
+    static thread_local const std::size_t t_tid =
+        static_cast<std::size_t>(::syscall(SYS_gettid));
+    return t_tid;
+#else
+    return std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+}
+
+inline int pid()
+{
+#ifdef _WIN32
+    return static_cast<int>(::GetCurrentProcessId());
+#else
+    return static_cast<int>(::getpid());
+#endif
+}
+
+inline bool is_tty(int fd)
+{
+#ifdef _WIN32
+    return ::_isatty(fd) != 0;
+#else
+    return ::isatty(fd) == 1;
+#endif
+}
+
+// write(2) all of data, resuming after short writes and EINTR.
+// false on error
+inline bool write_all(int fd, const char* data, std::size_t size)
+{
+    while (size)
+    {
+#ifdef _WIN32
+        int written = ::_write(fd, data, static_cast<unsigned>(size));
+#else
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+#endif
+        if (written <= 0)
+        {
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+// utc offset in minutes now, from the timezone cache
+inline int utc_minutes_offset()
+{
+    return static_cast<int>(TimeZone::instance().Offset(time(nullptr)) / 60);
+}
+
 //Return utc offset in minutes or -1 on failure
-inline int utc_minutes_offset(const std::tm& tm = os::localtime())
+inline int utc_minutes_offset(const std::tm& tm)
 {
 
 #ifdef _WIN32
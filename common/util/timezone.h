@@ -0,0 +1,240 @@
+// Copyright (C) 2015  wangxiaobo
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+* @Author: wangxiaobo
+* @Date:   2015-03-21 10:40:18
+* @Last Modified by:   wangxiaobo
+* @Last Modified time: 2015-03-21 16:02:55
+*/
+
+#ifndef PB_UTIL_TIMEZONE_H_
+#define PB_UTIL_TIMEZONE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+
+namespace pb
+{
+// cache of the local timezone's utc offset.
+// the offset in effect now is computed once, together with the time of the
+// next dst transition; until then local time is gmtime(t + offset), which
+// unlike localtime takes no lock and doesn't look at the TZ environment.
+// lookups are lock free: the cached window is published with a seqlock,
+// and a reader which races a refresh computes its answer directly instead
+// of waiting.
+// changes of TZ or of the system timezone after the first use are not seen.
+class TimeZone
+{
+public:
+    static TimeZone& instance()
+    {
+        static TimeZone s_instance;
+        return s_instance;
+    }
+
+    TimeZone(const TimeZone&) = delete;
+    TimeZone& operator=(const TimeZone&) = delete;
+
+    // utc offset in seconds at t
+    long Offset(std::time_t t)
+    {
+        return _Lookup(t).offset;
+    }
+
+    // like localtime_r, including tm_isdst (and tm_gmtoff where it exists)
+    std::tm LocalTime(std::time_t t)
+    {
+        Window w = _Lookup(t);
+        std::tm tm = _GmTime(t + w.offset);
+        tm.tm_isdst = w.isdst;
+#ifndef _WIN32
+        tm.tm_gmtoff = w.offset;
+#endif
+        return tm;
+    }
+
+    // like mktime: out of range fields are normalized, tm_isdst is ignored.
+    // a local time skipped by a dst transition maps to the same wall clock
+    // time in the old offset
+    std::time_t MakeTime(const std::tm& local)
+    {
+        std::int64_t year = local.tm_year + 1900LL + local.tm_mon / 12;
+        int month = local.tm_mon % 12;
+        if (month < 0)
+        {
+            month += 12;
+            --year;
+        }
+        std::int64_t secs = (_DaysFromCivil(year, month + 1, 1) + local.tm_mday - 1)
+                            * 86400LL + local.tm_hour * 3600LL
+                            + local.tm_min * 60LL + local.tm_sec;
+        // these lookups don't move the window: times far from now would
+        // push it away from the current time, which every log line needs
+        std::time_t guess = static_cast<std::time_t>(
+            secs - _Lookup(secs, false).offset);
+        return static_cast<std::time_t>(secs - _Lookup(guess, false).offset);
+    }
+
+private:
+    // the offset is known to hold in [from, until)
+    struct Window
+    {
+        long offset;
+        int isdst;
+        std::time_t from;
+        std::time_t until;
+    };
+
+    static const std::time_t kDay = 86400;
+    // how far ahead a transition is looked for
+    static const int kProbeDays = 400;
+
+    TimeZone()
+    {
+        // no support under vs2013 for member initialization for std::atomic
+        seq_ = 0;
+        offset_ = 0;
+        isdst_ = 0;
+        from_ = 0;
+        until_ = 0;
+    }
+
+    // refresh: move the window to t when it isn't there
+    Window _Lookup(std::time_t t, bool refresh = true)
+    {
+        unsigned seq = seq_.load(std::memory_order_acquire);
+        Window w;
+        w.offset = offset_.load(std::memory_order_relaxed);
+        w.isdst = isdst_.load(std::memory_order_relaxed);
+        w.from = from_.load(std::memory_order_relaxed);
+        w.until = until_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!(seq & 1) && seq == seq_.load(std::memory_order_relaxed)
+            && t >= w.from && t < w.until)
+        {
+            return w;
+        }
+        // times before the window (old timestamps) aren't worth a refresh
+        if (!refresh || seq & 1 || t < w.from)
+        {
+            return _Compute(t);
+        }
+        return _Refresh(t);
+    }
+
+    Window _Refresh(std::time_t t)
+    {
+        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            return _Compute(t);
+        }
+        Window w = _Compute(t);
+        // find the next transition: day steps, then bisect the last step
+        std::time_t lo = t;
+        std::time_t hi = t;
+        for (int i = 0; i < kProbeDays; ++i)
+        {
+            hi = lo + kDay;
+            if (_Compute(hi).offset != w.offset)
+            {
+                break;
+            }
+            lo = hi;
+        }
+        if (lo != hi)
+        {
+            while (hi - lo > 1)
+            {
+                std::time_t mid = lo + (hi - lo) / 2;
+                if (_Compute(mid).offset == w.offset)
+                {
+                    lo = mid;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+        }
+        w.until = hi;
+
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        offset_.store(w.offset, std::memory_order_relaxed);
+        isdst_.store(w.isdst, std::memory_order_relaxed);
+        from_.store(w.from, std::memory_order_relaxed);
+        until_.store(w.until, std::memory_order_relaxed);
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+        return w;
+    }
+
+    // the slow path: ask the C library. the window covers t only
+    static Window _Compute(std::time_t t)
+    {
+        Window w;
+        std::tm tm;
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+        w.offset = static_cast<long>(_mkgmtime(&tm) - t);
+#else
+        localtime_r(&t, &tm);
+        w.offset = static_cast<long>(tm.tm_gmtoff);
+#endif
+        w.isdst = tm.tm_isdst;
+        w.from = t;
+        w.until = t + 1;
+        return w;
+    }
+
+    static std::tm _GmTime(std::time_t t)
+    {
+        std::tm tm;
+#ifdef _WIN32
+        gmtime_s(&tm, &t);
+#else
+        gmtime_r(&t, &tm);
+#endif
+        return tm;
+    }
+
+    // days since 1970-01-01 of a proleptic gregorian date
+    static std::int64_t _DaysFromCivil(std::int64_t y, unsigned m, unsigned d)
+    {
+        y -= m <= 2;
+        std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+        unsigned yoe = static_cast<unsigned>(y - era * 400);
+        unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+    }
+
+    // odd while a refresh is publishing
+    std::atomic<unsigned> seq_;
+    std::atomic<long> offset_;
+    std::atomic<int> isdst_;
+    std::atomic<std::time_t> from_;
+    std::atomic<std::time_t> until_;
+    // one refresh at a time
+    std::mutex mutex_;
+};
+} // ns pb
+
+#endif // PB_UTIL_TIMEZONE_H_